@@ -35,10 +35,36 @@ char *cmbnms[] = {
 "FILTER",
 "FOLDL",
 "MERGE",
+"SORT",
+"MKSET",
+"LISTDIFF",
+"LISTDIFF1",
 "FOLDL1",
 "LIST_LAST",
 "FOLDR",
 "MATCH",
+"LISTARRAY",
+"ASUB",
+"ASIZE",
+"ASLICE",
+"AMAP",
+"LISTTABLE",
+"TINSERT",
+"TLOOKUP",
+"TDELETE",
+"TFOLD",
+"MEMO",
+"LINES",
+"SPLIT",
+"FIELD",
+"NEXTF",
+"JOIN",
+"JOIN1",
+"SEARCH",
+"PAR",
+"SPARK",
+"PARMAP",
+"PARMAP1",
 "MATCHINT",
 "TRY",
 "SUBSCRIPT",
@@ -112,6 +138,7 @@ char *cmbnms[] = {
 "G_ZERO",
 "G_CLOSE",
 "G_COUNT",
+"G_MEMO",
 "LEX_RPT",
 "LEX_RPT1",
 "LEX_TRY",
@@ -34,110 +34,137 @@
 #define FILTER (CMBASE+32)
 #define FOLDL (CMBASE+33)
 #define MERGE (CMBASE+34)
-#define FOLDL1 (CMBASE+35)
-#define LIST_LAST (CMBASE+36)
-#define FOLDR (CMBASE+37)
-#define MATCH (CMBASE+38)
-#define MATCHINT (CMBASE+39)
-#define TRY (CMBASE+40)
-#define SUBSCRIPT (CMBASE+41)
-#define ATLEAST (CMBASE+42)
-#define P (CMBASE+43)
-#define B_p (CMBASE+44)
-#define C_p (CMBASE+45)
-#define S1 (CMBASE+46)
-#define B1 (CMBASE+47)
-#define C1 (CMBASE+48)
-#define ITERATE (CMBASE+49)
-#define ITERATE1 (CMBASE+50)
-#define SEQ (CMBASE+51)
-#define FORCE (CMBASE+52)
-#define MINUS (CMBASE+53)
-#define PLUS (CMBASE+54)
-#define TIMES (CMBASE+55)
-#define INTDIV (CMBASE+56)
-#define FDIV (CMBASE+57)
-#define MOD (CMBASE+58)
-#define GR (CMBASE+59)
-#define GRE (CMBASE+60)
-#define POWER (CMBASE+61)
-#define CODE (CMBASE+62)
-#define DECODE (CMBASE+63)
-#define LENGTH (CMBASE+64)
-#define ARCTAN_FN (CMBASE+65)
-#define EXP_FN (CMBASE+66)
-#define ENTIER_FN (CMBASE+67)
-#define LOG_FN (CMBASE+68)
-#define LOG10_FN (CMBASE+69)
-#define SIN_FN (CMBASE+70)
-#define COS_FN (CMBASE+71)
-#define SQRT_FN (CMBASE+72)
-#define FILEMODE (CMBASE+73)
-#define FILESTAT (CMBASE+74)
-#define GETENV (CMBASE+75)
-#define EXEC (CMBASE+76)
-#define WAIT (CMBASE+77)
-#define INTEGER (CMBASE+78)
-#define SHOWNUM (CMBASE+79)
-#define SHOWHEX (CMBASE+80)
-#define SHOWOCT (CMBASE+81)
-#define SHOWSCALED (CMBASE+82)
-#define SHOWFLOAT (CMBASE+83)
-#define NUMVAL (CMBASE+84)
-#define STARTREAD (CMBASE+85)
-#define STARTREADBIN (CMBASE+86)
-#define NB_STARTREAD (CMBASE+87)
-#define READVALS (CMBASE+88)
-#define NB_READ (CMBASE+89)
-#define READ (CMBASE+90)
-#define READBIN (CMBASE+91)
-#define GETARGS (CMBASE+92)
-#define Ush (CMBASE+93)
-#define Ush1 (CMBASE+94)
-#define KI (CMBASE+95)
-#define G_ERROR (CMBASE+96)
-#define G_ALT (CMBASE+97)
-#define G_OPT (CMBASE+98)
-#define G_STAR (CMBASE+99)
-#define G_FBSTAR (CMBASE+100)
-#define G_SYMB (CMBASE+101)
-#define G_ANY (CMBASE+102)
-#define G_SUCHTHAT (CMBASE+103)
-#define G_END (CMBASE+104)
-#define G_STATE (CMBASE+105)
-#define G_SEQ (CMBASE+106)
-#define G_RULE (CMBASE+107)
-#define G_UNIT (CMBASE+108)
-#define G_ZERO (CMBASE+109)
-#define G_CLOSE (CMBASE+110)
-#define G_COUNT (CMBASE+111)
-#define LEX_RPT (CMBASE+112)
-#define LEX_RPT1 (CMBASE+113)
-#define LEX_TRY (CMBASE+114)
-#define LEX_TRY_ (CMBASE+115)
-#define LEX_TRY1 (CMBASE+116)
-#define LEX_TRY1_ (CMBASE+117)
-#define DESTREV (CMBASE+118)
-#define LEX_COUNT (CMBASE+119)
-#define LEX_COUNT0 (CMBASE+120)
-#define LEX_FAIL (CMBASE+121)
-#define LEX_STRING (CMBASE+122)
-#define LEX_CLASS (CMBASE+123)
-#define LEX_CHAR (CMBASE+124)
-#define LEX_DOT (CMBASE+125)
-#define LEX_SEQ (CMBASE+126)
-#define LEX_OR (CMBASE+127)
-#define LEX_RCONTEXT (CMBASE+128)
-#define LEX_STAR (CMBASE+129)
-#define LEX_OPT (CMBASE+130)
-#define MKSTRICT (CMBASE+131)
-#define BADCASE (CMBASE+132)
-#define CONFERROR (CMBASE+133)
-#define ERROR (CMBASE+134)
-#define FAIL (CMBASE+135)
-#define False (CMBASE+136)
-#define True (CMBASE+137)
-#define NIL (CMBASE+138)
-#define NILS (CMBASE+139)
-#define UNDEF (CMBASE+140)
-#define ATOMLIMIT (CMBASE+141)
+#define SORT (CMBASE+35)
+#define MKSET (CMBASE+36)
+#define LISTDIFF (CMBASE+37)
+#define LISTDIFF1 (CMBASE+38)
+#define FOLDL1 (CMBASE+39)
+#define LIST_LAST (CMBASE+40)
+#define FOLDR (CMBASE+41)
+#define MATCH (CMBASE+42)
+#define LISTARRAY (CMBASE+43)
+#define ASUB (CMBASE+44)
+#define ASIZE (CMBASE+45)
+#define ASLICE (CMBASE+46)
+#define AMAP (CMBASE+47)
+#define LISTTABLE (CMBASE+48)
+#define TINSERT (CMBASE+49)
+#define TLOOKUP (CMBASE+50)
+#define TDELETE (CMBASE+51)
+#define TFOLD (CMBASE+52)
+#define MEMO (CMBASE+53)
+#define LINES (CMBASE+54)
+#define SPLIT (CMBASE+55)
+#define FIELD (CMBASE+56)
+#define NEXTF (CMBASE+57)
+#define JOIN (CMBASE+58)
+#define JOIN1 (CMBASE+59)
+#define SEARCH (CMBASE+60)
+#define PAR (CMBASE+61)
+#define SPARK (CMBASE+62)
+#define PARMAP (CMBASE+63)
+#define PARMAP1 (CMBASE+64)
+#define MATCHINT (CMBASE+65)
+#define TRY (CMBASE+66)
+#define SUBSCRIPT (CMBASE+67)
+#define ATLEAST (CMBASE+68)
+#define P (CMBASE+69)
+#define B_p (CMBASE+70)
+#define C_p (CMBASE+71)
+#define S1 (CMBASE+72)
+#define B1 (CMBASE+73)
+#define C1 (CMBASE+74)
+#define ITERATE (CMBASE+75)
+#define ITERATE1 (CMBASE+76)
+#define SEQ (CMBASE+77)
+#define FORCE (CMBASE+78)
+#define MINUS (CMBASE+79)
+#define PLUS (CMBASE+80)
+#define TIMES (CMBASE+81)
+#define INTDIV (CMBASE+82)
+#define FDIV (CMBASE+83)
+#define MOD (CMBASE+84)
+#define GR (CMBASE+85)
+#define GRE (CMBASE+86)
+#define POWER (CMBASE+87)
+#define CODE (CMBASE+88)
+#define DECODE (CMBASE+89)
+#define LENGTH (CMBASE+90)
+#define ARCTAN_FN (CMBASE+91)
+#define EXP_FN (CMBASE+92)
+#define ENTIER_FN (CMBASE+93)
+#define LOG_FN (CMBASE+94)
+#define LOG10_FN (CMBASE+95)
+#define SIN_FN (CMBASE+96)
+#define COS_FN (CMBASE+97)
+#define SQRT_FN (CMBASE+98)
+#define FILEMODE (CMBASE+99)
+#define FILESTAT (CMBASE+100)
+#define GETENV (CMBASE+101)
+#define EXEC (CMBASE+102)
+#define WAIT (CMBASE+103)
+#define INTEGER (CMBASE+104)
+#define SHOWNUM (CMBASE+105)
+#define SHOWHEX (CMBASE+106)
+#define SHOWOCT (CMBASE+107)
+#define SHOWSCALED (CMBASE+108)
+#define SHOWFLOAT (CMBASE+109)
+#define NUMVAL (CMBASE+110)
+#define STARTREAD (CMBASE+111)
+#define STARTREADBIN (CMBASE+112)
+#define NB_STARTREAD (CMBASE+113)
+#define READVALS (CMBASE+114)
+#define NB_READ (CMBASE+115)
+#define READ (CMBASE+116)
+#define READBIN (CMBASE+117)
+#define GETARGS (CMBASE+118)
+#define Ush (CMBASE+119)
+#define Ush1 (CMBASE+120)
+#define KI (CMBASE+121)
+#define G_ERROR (CMBASE+122)
+#define G_ALT (CMBASE+123)
+#define G_OPT (CMBASE+124)
+#define G_STAR (CMBASE+125)
+#define G_FBSTAR (CMBASE+126)
+#define G_SYMB (CMBASE+127)
+#define G_ANY (CMBASE+128)
+#define G_SUCHTHAT (CMBASE+129)
+#define G_END (CMBASE+130)
+#define G_STATE (CMBASE+131)
+#define G_SEQ (CMBASE+132)
+#define G_RULE (CMBASE+133)
+#define G_UNIT (CMBASE+134)
+#define G_ZERO (CMBASE+135)
+#define G_CLOSE (CMBASE+136)
+#define G_COUNT (CMBASE+137)
+#define G_MEMO (CMBASE+138)
+#define LEX_RPT (CMBASE+139)
+#define LEX_RPT1 (CMBASE+140)
+#define LEX_TRY (CMBASE+141)
+#define LEX_TRY_ (CMBASE+142)
+#define LEX_TRY1 (CMBASE+143)
+#define LEX_TRY1_ (CMBASE+144)
+#define DESTREV (CMBASE+145)
+#define LEX_COUNT (CMBASE+146)
+#define LEX_COUNT0 (CMBASE+147)
+#define LEX_FAIL (CMBASE+148)
+#define LEX_STRING (CMBASE+149)
+#define LEX_CLASS (CMBASE+150)
+#define LEX_CHAR (CMBASE+151)
+#define LEX_DOT (CMBASE+152)
+#define LEX_SEQ (CMBASE+153)
+#define LEX_OR (CMBASE+154)
+#define LEX_RCONTEXT (CMBASE+155)
+#define LEX_STAR (CMBASE+156)
+#define LEX_OPT (CMBASE+157)
+#define MKSTRICT (CMBASE+158)
+#define BADCASE (CMBASE+159)
+#define CONFERROR (CMBASE+160)
+#define ERROR (CMBASE+161)
+#define FAIL (CMBASE+162)
+#define False (CMBASE+163)
+#define True (CMBASE+164)
+#define NIL (CMBASE+165)
+#define NILS (CMBASE+166)
+#define UNDEF (CMBASE+167)
+#define ATOMLIMIT (CMBASE+168)
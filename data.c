@@ -11,6 +11,12 @@
 #include "data.h"
 #include "big.h"
 #include "lex.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <setjmp.h>
+#include <pthread.h>
 #define INITSPACE 1250000
 word SPACE=INITSPACE; /* false ceiling in heap to improve paging behaviour
 			during compilation */
@@ -26,7 +32,7 @@ word *hdspace,*tlspace;
 long long cellcount=0;
 long claims=0;
 long nogcs=0;
-extern int atgc,loading; /* flags, set in steer.c */
+extern int atgc,loading,gcthreads; /* flags, set in steer.c */
 char *tag;
 
 word *dstack=0,*stackp,*dlim;
@@ -40,15 +46,48 @@ word current_file;
    /* safest to test for -ve chars this way, since not all m/c's do sign
       extension - DT Jan 84 */
 
+/* for parallel marking, see gcmark() */
+#define GCTMAX 64 /* most threads, see -gcthreads in steer.c */
+#define GCCHUNK 256
+struct gcchunk { struct gcchunk *next; word n,v[GCCHUNK]; };
+struct gcthread { pthread_t id; word *s,n,size,lo,hi; };
+static struct gcthread gct[GCTMAX];
+static struct gcchunk *gcpool=NULL,*gcspare=NULL;
+static word gcpooled,gchungry,gcidle,gcnt,gcdone,gcend;
+  /* chunks in the pool, threads waiting for one, threads idle, threads,
+     marking over, and the first cell never used - gcpooled and gchungry are
+     read without the lock, so are always written atomically */
+static word gcdefer=0,*gcroots=NULL,ngcroots=0,gcrootsize=0;
+static unsigned long *gcbits=NULL;
+static word gcbitsize=0;
+static pthread_mutex_t gclock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gcwake=PTHREAD_COND_INITIALIZER;
+#define gcword(x) gcbits[((x)-ATOMLIMIT)/__WORDSIZE]
+#define gcbit(x) (1UL<<((x)-ATOMLIMIT)%__WORDSIZE)
+#define gcpush(t,x) ((t)->n==(t)->size?gcgrow(t):0,(t)->s[(t)->n++]=(x))
+#define gcset(v,x) __atomic_store_n(&(v),x,__ATOMIC_RELAXED)
+#define gcget(v) __atomic_load_n(&(v),__ATOMIC_RELAXED)
+
 static void bases(void);
 static void bindparams(word,word);
 static void dsetup(void);
-static void dump_defs(word,FILE *);
-static void dump_ob(word,FILE *);
+static void dump_defs(word);
+static void dump_ob(word);
+static void freearrays(void);
+static struct gcchunk *gcchunk(void);
+static void gcfollow(struct gcthread *,word);
+static word gcgrow(struct gcthread *);
+static void gcmark(void);
+static void gcshare(struct gcthread *);
+static void *gcsweep(void *);
+static word gctake(struct gcthread *);
+static void *gcwork(void *);
+static word growmstack(void);
 static word hdsort(word);
-static word load_defs(FILE *);
-static void mark(word);
+static word load_defs(void);
+static word load_files(char *,word,word,word);
 static void unscramble(word);
+static word vecob(word,word,word);
 
 word trueheapsize()
 { return(nogcs==0?listp-ATOMLIMIT+1:SPACE); }
@@ -167,8 +206,12 @@ void gc()       /*  the "garbage collector"  */
         exit(1); } /* if compiling should reset() instead - FIX LATER */
     else hnogcs=nogcs+1; }
   nogcs++;
+  if(gcthreads>1) /* see gcmark() */
+    gcdefer=1,gcend=(char *)memchr(p1,0,TOP+1-ATOMLIMIT)-tag; else
   while(*p1= -*p1)p1++;  /* make all tags -ve (= unwanted) */
   bases();
+  freearrays();
+  spark_reap();
 /*if(atgc)printf("bases() done\n"); /* DEBUG */
   listp= ATOMLIMIT - 1;
   cellcount+= claims;
@@ -180,12 +223,14 @@ void gc()       /*  the "garbage collector"  */
 void gcpatch() /* called when gc interrupted - see reset in steer.c */
 /* must not allocate any cells between calling this and next gc() */
 { char *p1; 
+  gcdefer=ngcroots=0;
   for(p1= &(tag[ATOMLIMIT]);*p1;p1++)if(negchar(*p1))*p1= -*p1;
  /* otherwise mutator crashes on funny tags */
 }
 
 void bases()  /*  marks everthing that must be saved  */
 { word *p;
+  jmp_buf regs;
   extern YYSTYPE yyval;
   extern word *cstack;
   extern word fileq,primenv;
@@ -194,8 +239,8 @@ void bases()  /*  marks everthing that must be saved  */
   extern word idsused,suppressids,lastname,
              eprodnts,nonterminals,ntmap,ihlist,ntspecmap,gvars,lexvar;
   extern word R,TABSTRS,SGC,ND,SBND,NT,current_id,meta_pending;
-  extern word showchain,newtyps,algshfns,errs,speclocs;
-  extern word SUBST[],tvmap,localtvmap;
+  extern word showchain,newtyps,algshfns,errs,speclocs,tcache,tcfresh;
+  extern word tvmap,localtvmap;
   extern word tfnum,tfbool,tfbool2,tfnum2,tfstrstr,
 	     tfnumnum,ltchar,bnf_t,tstep,tstepuntil;
   extern word exec_t,read_t,filestat_t;
@@ -204,9 +249,13 @@ void bases()  /*  marks everthing that must be saved  */
   extern word lexstates,lexdefs,oldfiles,includees,embargoes,exportfiles,
              exports,internals, freeids,tlost,detrop,rfl,bereaved,ld_stuff;
   extern word CLASHES,ALIASES,SUPPRESSED,TSUPPRESSED,DETROP,MISSING,fnts,FBS;
-  extern word outfilq,waiting;
+  extern word outfilq,waiting,sparked,kmp_p;
   /* Icount=0; /* DEBUG */
+  memset(regs,0,sizeof(regs)); /* setjmp may not fill all of it */
+  setjmp(regs); /* a pointer held only in a register is now on the stack */
   p= (word *)&p;
+  if(p<cstack&&(word *)regs<=p)p=(word *)regs-1; else
+  if(p>cstack&&(word *)regs>=p)p=(word *)(regs+1);
 /* we follow everything on the C stack that looks like  a  pointer  into
 list space. This is failsafe in that the worst that can happen,if e.g. a
 stray integer happens to point into list  space,  is  that  the  garbage
@@ -219,9 +268,12 @@ collector will collect less garbage than it could have done */
 /* now follow all pointer-containing external variables */
   mark(outfilq);
   mark(waiting);
-  if(compiling||rv_expr||rv_script) /* rv flags indicate `readvals' in use */
+  mark(kmp_p); /* pattern of the last search, see kmp() */
+  if(compiling||rv_expr||rv_script||sparked)
+  /* rv flags indicate `readvals' in use, sparked that a child process may
+     send back constructors, by address - see send_val() */
   { extern YYSTYPE *yyvs, *yyvsp;
-    extern word namebucket[];
+    extern word *idtab,idtabsize;
     extern word *pnvec,nextpn;  /* private name vector */
     extern word make_status;
     word i;
@@ -259,8 +311,8 @@ collector will collect less garbage than it could have done */
     mark(FBS);
     mark(lexstates);
     mark(lexdefs);
-    for(i=0;i<128;i++)
-       if(namebucket[i])mark(namebucket[i]);
+    for(i=0;i<idtabsize;i++)
+       if(idtab[i])mark(idtab[i]);
     for(p=dstack;p<stackp;p++)mark(*p);
     if(loading)
       { mark(algshfns);
@@ -292,6 +344,8 @@ collector will collect less garbage than it could have done */
     mark(meta_pending);
     mark(newtyps);
     mark(showchain);
+    mark(tcache);
+    mark(tcfresh);
     mark(errs);
     mark(tfnum);
     mark(tfbool);
@@ -307,19 +361,251 @@ collector will collect less garbage than it could have done */
     mark(tstep);
     mark(tstepuntil);
     mark(tvmap);
-    mark(localtvmap);
-    for(i=0;i<hashsize;i++)mark(SUBST[i]); }
+    mark(localtvmap); }
+  if(gcdefer)gcmark();
+  memo_mark(); /* must be last, see reduce.c */
 /*  if(atgc)printf("<<%d I-nodes>>\n",Icount); /* DEBUG */
 }
 
+/* parallel marking - when gcthreads (flag -gcthreads) is more than 1, mark()
+   called from bases() only collects the roots, and gcmark() marks from them
+   with that many threads, the mutator being stopped.  The mark bits are kept
+   to one side, in gcbits, a cell being claimed by the thread that sets its
+   bit, by an atomic test-and-set, so that each is followed once.  A thread
+   follows hd, keeping the tl fields on a stack of its own as mark() does,
+   and while others are idle gives away the oldest part of its stack, as a
+   chunk in a shared pool, from which idle threads take their work - the
+   roots are put there to start with.  Marking is over when all the threads
+   are idle with the pool empty.  The tags are then swept in slices, one to
+   each thread, the tag of each cell in use that was not reached being made
+   -ve, which leaves them as mark() would have for memo_mark() and the rest
+   of gc().  Signals are held off meanwhile, see gcpatch() */
+
+static void gcmark() /* called from bases(), see above */
+{ word i,j,k,size;
+  struct gcchunk *c;
+  sigset_t all,old;
+  gcdefer=0;
+  i=(SPACE+__WORDSIZE-1)/__WORDSIZE;
+  if(i>gcbitsize)
+    { gcbits=(unsigned long *)realloc(gcbits,i*sizeof(unsigned long));
+      if(gcbits==NULL)mallocfail("garbage collector");
+      memset(gcbits+gcbitsize,0,(i-gcbitsize)*sizeof(unsigned long));
+      gcbitsize=i; }
+  for(i=0;i<ngcroots;i+=GCCHUNK)
+     { if((c=gcchunk())==NULL)mallocfail("garbage collector");
+       for(c->n=0;c->n<GCCHUNK&&i+c->n<ngcroots;c->n++)c->v[c->n]=gcroots[i+c->n];
+       c->next=gcpool,gcpool=c,gcpooled++; }
+  ngcroots=gchungry=gcidle=gcdone=0,gcnt=1;
+  sigfillset(&all);
+  pthread_sigmask(SIG_BLOCK,&all,&old); /* the threads inherit this */
+  for(k=1;k<gcthreads&&k<GCTMAX;k++)
+     { pthread_mutex_lock(&gclock);
+       gcnt++;
+       pthread_mutex_unlock(&gclock);
+       if(pthread_create(&gct[k].id,NULL,gcwork,gct+k))
+         { pthread_mutex_lock(&gclock);
+           gcnt--;
+           pthread_mutex_unlock(&gclock);
+           break; } }
+  gcwork(gct);
+  for(j=1;j<k;j++)pthread_join(gct[j].id,NULL);
+  size=((gcend-ATOMLIMIT)/k/__WORDSIZE+1)*__WORDSIZE; /* whole words of gcbits */
+  for(j=0;j<k;j++)
+     { gct[j].lo=ATOMLIMIT+j*size,gct[j].hi=gct[j].lo+size;
+       if(gct[j].hi>gcend)gct[j].hi=gcend;
+       if(gct[j].lo>gct[j].hi)gct[j].lo=gct[j].hi; }
+  for(j=1;j<k;j++)
+     if(pthread_create(&gct[j].id,NULL,gcsweep,gct+j))
+       gcsweep(gct+j),gct[j].lo= -1;
+  gcsweep(gct);
+  for(j=1;j<k;j++)
+     if(gct[j].lo>=0)pthread_join(gct[j].id,NULL);
+  pthread_sigmask(SIG_SETMASK,&old,NULL);
+}
+
+static void *gcwork(arg) /* body of a marking thread */
+void *arg;
+{ struct gcthread *t=(struct gcthread *)arg;
+  do while(t->n)
+       { gcfollow(t,t->s[--t->n]);
+         if(t->n>1&&gcget(gchungry)>gcget(gcpooled))gcshare(t); }
+  while(gctake(t));
+  return(NULL);
+}
+
+static void gcfollow(t,x) /* marks x and what it leads to, as mark() */
+struct gcthread *t;
+word x;
+{ for(;;)
+  { x&= ~tlptrbits;
+    if(!isptr(x)||x>=gcend||negchar(tag[x])||!tag[x])return;
+    if((gcget(gcword(x))&gcbit(x))||
+       (__atomic_fetch_or(&gcword(x),gcbit(x),__ATOMIC_RELAXED)&gcbit(x)))
+      return; /* another thread has it */
+    if(tag[x]<INT)
+      { if(tag[x]!=TVAR)return;
+        x=hd[x]; continue; }
+    if(tag[x]==ARRAY||tag[x]==HAMT)
+      { word i=tag[x]==ARRAY?tl[x]:hamtsize(x),*v=arrayv(x);
+        while(i--)gcpush(t,v[i]);
+        return; }
+    if(tag[x]<=STRCONS){ x=tl[x]; continue; }
+    gcpush(t,tl[x]);
+    x=hd[x]; }
+}
+
+static word gcgrow(t)
+struct gcthread *t;
+{ t->size=t->size?2*t->size:1024;
+  t->s=(word *)realloc(t->s,t->size*sizeof(word));
+  if(t->s==NULL)mallocfail("garbage collector");
+  return(0);
+}
+
+static struct gcchunk *gcchunk() /* a chunk to fill, the caller has gclock */
+{ struct gcchunk *c=gcspare;
+  if(c)gcspare=c->next;
+  else c=(struct gcchunk *)malloc(sizeof(struct gcchunk));
+  return(c);
+}
+
+static void gcshare(t) /* gives the oldest part of t's stack to the pool */
+struct gcthread *t;
+{ struct gcchunk *c;
+  word k=t->n/2;
+  if(k>GCCHUNK)k=GCCHUNK;
+  pthread_mutex_lock(&gclock);
+  if(gchungry>gcpooled&&(c=gcchunk())!=NULL)
+    { memcpy(c->v,t->s,k*sizeof(word));
+      memmove(t->s,t->s+k,(t->n-k)*sizeof(word));
+      c->n=k,t->n-=k;
+      c->next=gcpool,gcpool=c;
+      gcset(gcpooled,gcpooled+1);
+      pthread_cond_signal(&gcwake); }
+  pthread_mutex_unlock(&gclock);
+}
+
+static word gctake(t) /* fills t's stack from the pool, waiting if need be -
+                         returns 0 when marking is over */
+struct gcthread *t;
+{ struct gcchunk *c;
+  pthread_mutex_lock(&gclock);
+  while(gcpool==NULL&&!gcdone)
+       if(++gcidle==gcnt)gcdone=1,pthread_cond_broadcast(&gcwake);
+       else { gcset(gchungry,gchungry+1);
+              pthread_cond_wait(&gcwake,&gclock);
+              gcset(gchungry,gchungry-1);
+              gcidle--; }
+  if((c=gcpool)!=NULL)
+    { gcpool=c->next;
+      gcset(gcpooled,gcpooled-1);
+      while(t->size<c->n)gcgrow(t);
+      memcpy(t->s,c->v,c->n*sizeof(word));
+      t->n=c->n;
+      c->next=gcspare,gcspare=c; }
+  pthread_mutex_unlock(&gclock);
+  return(c!=NULL);
+}
+
+static void *gcsweep(arg) /* makes -ve the tags of the cells in use not
+                             reached, in t->lo..t->hi-1, clearing their bits */
+void *arg;
+{ struct gcthread *t=(struct gcthread *)arg;
+  word x;
+  for(x=t->lo;x<t->hi;x++)
+     if(!(gcword(x)&gcbit(x))&&!negchar(tag[x])&&tag[x])tag[x]= -tag[x];
+  if(t->lo<t->hi)
+    memset(&gcword(t->lo),0,
+           (t->hi-t->lo+__WORDSIZE-1)/__WORDSIZE*sizeof(unsigned long));
+  return(NULL);
+}
+
+/* mark() follows hd by iteration, as a recursive version would, keeping on a
+   stack of its own the tl fields it has still to follow - a structure nested
+   deeply through hd, such as a long left-nested tree, would otherwise
+   overflow the C stack in the middle of a gc */
+static word *mstack=NULL,mstacksize=0;
+#define mpush(x) (n==mstacksize?growmstack():0,mstack[n++]=(x))
+
+static word growmstack()
+{ mstacksize=mstacksize?2*mstacksize:1024;
+  mstack=(word *)realloc(mstack,mstacksize*sizeof(word));
+  if(mstack==NULL)mallocfail("garbage collector");
+  return(0);
+}
+
 void mark(x)   /* a marked cell is distinguished by having a +ve "tag" */
 word x;
-{ x&= ~tlptrbits; /* x may be a `reversed pointer' (see reduce.c) */
-  while(isptr(x)&&negchar(tag[x]))
-  { /*if(hd[x]==I)Icount++; /* DEBUG */
-    if((tag[x]= -tag[x])<INT)return;
-    if(tag[x]>STRCONS)mark(hd[x]);
-    x= tl[x]&~tlptrbits; }
+{ word n=0; /* depth of mstack */
+  if(gcdefer) /* a root, see gcmark() */
+    { x&= ~tlptrbits;
+      if(!isptr(x)||x>=gcend||negchar(tag[x])||!tag[x])return;
+      if(ngcroots==gcrootsize)
+        { gcrootsize=gcrootsize?2*gcrootsize:1024;
+          gcroots=(word *)realloc(gcroots,gcrootsize*sizeof(word));
+          if(gcroots==NULL)mallocfail("garbage collector"); }
+      gcroots[ngcroots++]=x;
+      return; }
+  for(;;)
+  { x&= ~tlptrbits; /* x may be a `reversed pointer' (see reduce.c) */
+    while(isptr(x)&&negchar(tag[x]))
+    { /*if(hd[x]==I)Icount++; /* DEBUG */
+      if((tag[x]= -tag[x])<INT)
+        { if(tag[x]!=TVAR)break;
+          x=hd[x]; continue; } /* binding of a type variable */
+      if(tag[x]==ARRAY||tag[x]==HAMT)
+        { word i=tag[x]==ARRAY?tl[x]:hamtsize(x),*v=arrayv(x);
+          while(i--)mpush(v[i]);
+          break; }
+      if(tag[x]<=STRCONS){ x=tl[x]&~tlptrbits; continue; }
+      mpush(tl[x]);
+      x=hd[x]&~tlptrbits; }
+    if(n==0)return;
+    x=mstack[--n]; }
+}
+
+/* the vector of an array lies outside the heap, so gc() must free it when
+   the ARRAY cell becomes garbage - arrays[] lists the ARRAY cells in use,
+   and the HAMT cells, whose vectors are treated the same way */
+static word *arrays=NULL,narrays=0,arrayspace=0;
+
+static word vecob(t,n,x) /* a cell with tag t, x in tl, and in hd a vector
+                            with room for n words */
+word t,n,x;
+{ word a,*v=(word *)malloc((n?n:1)*sizeof(word));
+  if(v==NULL)mallocfail("array");
+  while(n--)v[n]=NIL;
+  if(narrays==arrayspace)
+    { arrayspace=arrayspace?2*arrayspace:256;
+      arrays=(word *)realloc(arrays,arrayspace*sizeof(word));
+      if(arrays==NULL)mallocfail("array"); }
+  a=make(t,(word)v,x);
+  arrays[narrays++]=a;
+  return(a);
+}
+
+word mkarray(n) /* an array with room for n elements - the caller fills them
+                   in, raising tl as it goes, so gc sees only those present */
+word n;
+{ return(vecob(ARRAY,n,0));
+}
+
+word mkhamt(b) /* a table node with bitmap b, its slots NIL until the caller
+                  fills them in - see tables in reduce.c */
+word b;
+{ return(vecob(HAMT,__builtin_popcountl(b),b));
+}
+
+static void freearrays() /* called by gc() after marking */
+{ word i,j;
+  for(i=j=0;i<narrays;i++)
+     if(negchar(tag[arrays[i]]))
+       { free(arrayv(arrays[i]));
+         tag[arrays[i]]= -DOUBLE; } /* so a stale pointer from the stack
+                                      can't revive the dead vector */
+     else arrays[j++]=arrays[i];
+  narrays=j;
 }
 
 /* test added Jan 2020 - DT */
@@ -394,6 +680,71 @@ int is_char(x)
 word x;
 { return 0<=x && x<256 || tag[x]==UNICODE; }
 
+/* a character class [...] or [^...] from %lex is compiled to a chain of
+   CHARSET cells, each holding a raw word in hd.  The first CSWORDS of these
+   are a bitmap of the chars 0..255 in the class, the rest are pairs lo,hi
+   giving the ranges of chars above 255 in the class, in ascending order.
+   So inset() costs the same for any class, where lex once walked the list
+   of chars and ranges for each input char. */
+
+static word mkcharset(word *,word,word);
+
+word charset(x,anti) /* x is a list of chars and DOTDOT ranges, as made by
+                        charclass() in lex.c, anti for [^...] */
+word x,anti;
+{ word n=0,*r,y;
+  for(y=x;y!=NIL;y=tl[y])n++;
+  r=(word *)malloc((2*n+2)*sizeof(word));
+  if(r==NULL)mallocfail("charset");
+  for(n=0;x!=NIL;x=tl[x],n++)
+     if(hd[x]==DOTDOT)
+       { x=tl[x]; r[2*n]=get_char(hd[x]);
+         x=tl[x]; r[2*n+1]=get_char(hd[x]); }
+     else r[2*n]=r[2*n+1]=get_char(hd[x]);
+  x=mkcharset(r,n,anti);
+  free(r);
+  return(x);
+}
+
+static word mkcharset(r,n,anti) /* from n ranges lo,hi in r[], in any order,
+                                   r must have room for 2*n+2 words */
+word *r,n,anti;
+{ word bits[CSWORDS],i,j,lo,hi,s=NIL;
+  for(i=0;i<CSWORDS;i++)bits[i]=0;
+  for(i=0;i<n;i++) /* insertion sort on lo, filling in bitmap as we go */
+     { lo=r[2*i],hi=r[2*i+1];
+       for(j=lo;j<=hi&&j<256;j++)bits[j/__WORDSIZE]|=1UL<<j%__WORDSIZE;
+       for(j=i;j>0&&r[2*j-2]>lo;j--)r[2*j]=r[2*j-2],r[2*j+1]=r[2*j-1];
+       r[2*j]=lo,r[2*j+1]=hi; }
+  for(i=j=0;i<n;i++) /* merge ranges above 255 */
+     { lo=r[2*i]<256?256:r[2*i],hi=r[2*i+1];
+       if(hi<lo)continue;
+       if(j&&lo<=r[2*j-1]+1){ if(hi>r[2*j-1])r[2*j-1]=hi; }
+       else r[2*j]=lo,r[2*j+1]=hi,j++; }
+  n=j;
+  if(!anti)
+    for(i=n;i-->0;)s=make(CHARSET,r[2*i],make(CHARSET,r[2*i+1],s));
+  else for(i=n,hi=UMAX;i>=0;i--) /* gaps between ranges, from the top */
+         { lo=i?r[2*i-1]+1:256;
+           if(lo<=hi)s=make(CHARSET,lo,make(CHARSET,hi,s));
+           if(i)hi=r[2*i-2]-1; }
+  for(i=CSWORDS;i-->0;)s=make(CHARSET,anti?~bits[i]:bits[i],s);
+  return(s);
+}
+
+int inset(c,s) /* is char c in CHARSET s */
+word c,s;
+{ int i;
+  if(c<256)
+    { while(c>=__WORDSIZE)c-=__WORDSIZE,s=tl[s];
+      return((unsigned long)hd[s]>>c&1); }
+  c=get_char(c);
+  for(i=0;i<CSWORDS;i++)s=tl[s];
+  for(;s!=NIL&&hd[s]<=c;s=tl[tl[s]])
+     if(c<=hd[tl[s]])return(1);
+  return(0);
+}
+
 word sto_id(p1)
 char *p1;
 { return(make(ID,cons(strcons(p1,NIL),undef_t),UNDEF)); }
@@ -404,7 +755,23 @@ char *p1;
   /* hereinfo is fileinfo(script,line_no) */
 
 /* hereafter is stuff for dumping and undumping compiled scripts
-   w means (sizeof(word)) in bytes
+
+   A dump begins with a header and a table of sections
+
+        'M' 'x' XVERSION kind nsections
+        [ id <4 bytes offset> <4 bytes length> ]*nsections
+
+   kind is 0 for a syntax-error script, 1 for a type-error script, 2 for a
+   correct one, and offsets are from the start of the file.  Multibyte
+   quantities in the header are low order byte first.  There are three
+   sections at present, XS_STRINGS which is a count followed by that many
+   strings, each terminated by '\0', XS_CODE which holds the script as
+   a postfix sequence of bytes, and XS_HASHES which holds a hash of the
+   contents of each source file, 8 bytes each, in the order the filenames
+   appear in the code.  Strings (identifiers, aliases and pathnames)
+   appear in the code by their index in XS_STRINGS, so each is stored once.
+   <n> below is a number in varint form - 7 bits per byte, low order first,
+   with the top bit set in all but the last byte.
 
    (internal heap object)       (external file rep - char sequence)
    ----------------------       -----------------------------------
@@ -412,32 +779,34 @@ char *p1;
    128..383                     CHAR_X (self-128)
    384..ATOMLIMIT-1             (self-256)
    integer (-127..127)          SHORT_X <byte>
-   integer                      INT_X <4n bytes> (-1)
-   double                       DBL_X <8 bytes>
-   unicode_char                 UNICODE_X <4 bytes>
-   typevar                      TVAR_X <byte>
+   integer                      INT_X <ndigits> <digit0*2+sign> <digit>*
+   double                       DBL_X <8 bytes>  (low order first)
+   unicode_char                 UNICODE_X <n>
+   charset                      CHARSET_X <n> [<lo> <hi>]*         (n ranges)
+   array of x1..xn              [x1] .. [xn] ARRAY_X <n>
+   table of k1:=v1..kn:=vn      [k1] [v1] .. [kn] [vn] HAMT_X <n>
+   typevar                      TVAR_X <n>
    ap(x,y)                      [x] [y] AP_X
+   ap(..ap(ap(f,x1),x2)..,xn)   [f] [x1] [x2] .. [xn] APN_X <n>      (n>1)
    cons(x,y)                    [y] [x] CONS_X
-   id (=occurrence)             ID_X <string terminated by '\0'>
-   pname (=occurrence)          PN_X <2 bytes>
-                                PN1_X <4 bytes>
-   datapair(string,0)           AKA_X <string...\0>
-   fileinfo(script,line_no)     HERE_X <string...\0> <2 bytes>     (**)
-   constructor(n,x)             [x] CONSTRUCT_X <2 bytes>
+   x1:x2:..:xn:y                [y] [xn] .. [x2] [x1] LIST_X <n>     (n>1)
+   id (=occurrence)             ID_X <string>
+   pname (=occurrence)          PN_X <n>
+   datapair(string,0)           AKA_X <string>
+   fileinfo(script,line_no)     HERE_X <string+1> <line_no>        (**)
+   constructor(n,x)             [x] CONSTRUCT_X <n>
    readvals(h,t)                [t] RV_X
    definition                   [val] [type] [who] [id] DEF_X
                                 [val] [pname] DEF_X
    definition-list              [definition*] DEF_X
-   filename                     <string terminated by '\0'>
-   mtime                        <w bytes>
+   filename                     <string+1>
+   mtime                        <n>  (zigzag, see xputz)
 
-   complete script              __WORDSIZE
-				XVERSION
-                                [ [filename]
+   code of complete script      [ [filename]
                                   [mtime]
                                   [shareable]          (=0 or 1)
                                   [definition-list] ]+
-                                '\0'
+                                0
                                 [definition-list]      (algshfns)
                                 [ND] or [True]         (see below)
                                 DEF_X
@@ -447,34 +816,33 @@ char *p1;
                                 DEF_X
                                 [definition-list]      (internals)
 
-   type-error script            __WORDSIZE
-                                XVERSION
-                                '\1'
-                                <w bytes>  (=errline)
+   code of type-error script    <errline>
                                 ... (rest as normal script)
 
-   syntax-error script          __WORDSIZE
-                                XVERSION
-                                `\0'
-                                <w bytes>  (=errline)
+   code of syntax-error script  <errline>
                                 [ [filename]
                                   [mtime] ]+
+                                0
 
    Notes
    -----
    first filename in dump must be that of `current_script' (ie the
    main source file).  All pathnames in dump are correct wrt the
    directory of the main source.
-   (**) empty string is abbreviation for current filename in hereinfo
+   (**) 0 is abbreviation for current filename in hereinfo, otherwise the
+   string index is stored plus one, as in filenames
    True in ND position indicates an otherwise correct dump whose exports
    include type orphans
+   Nothing in the format depends on the word size or byte order of the
+   machine, but combinator numbers change with XVERSION.
+   A file whose mtime differs from that in the dump but whose contents
+   hash as recorded is taken to be unchanged, see xfresh() - so a dump
+   survives its sources being copied or checked out again.
 
    Pending:
    --------
-   could have abbreviation for iterated ap and cons
-
-   remaining issue - external format should be machine and version
-   independent - not clear how to do this
+   could share common subexpressions, which are at present dumped once
+   for each occurrence
 */
 
 #define XBASE ATOMLIMIT-256
@@ -488,51 +856,112 @@ char *p1;
 #define CONSTRUCT_X (XBASE+7)
 #define RV_X (XBASE+8)
 #define PN_X (XBASE+9)
-#define PN1_X (XBASE+10)
+#define APN_X (XBASE+10)
 #define DEF_X (XBASE+11)
 #define AP_X (XBASE+12)
 #define CONS_X (XBASE+13)
 #define TVAR_X (XBASE+14)
 #define UNICODE_X (XBASE+15)
-#define XLIMIT (XBASE+16)
-#if XLIMIT>512
-#error "coding scheme breaks down: XLIMIT>512"
+#define LIST_X (XBASE+16)
+#define CHARSET_X (XBASE+17)
+#define ARRAY_X (XBASE+18)
+#define HAMT_X (XBASE+19)
+#define XLIMIT (XBASE+20)
+#if XLIMIT>256
+#error "coding scheme breaks down: XLIMIT>256"
 #endif
 
-void putword(x,f)
-word x;
-FILE *f;
-{ int i=sizeof(word);
-  putc(x&255,f);
-  while(--i)x>>=8,putc(x&255,f);
+#define XS_STRINGS 1
+#define XS_CODE 2
+#define XS_HASHES 3
+#define XHEADER 32 /* size of header with three sections */
+
+/* the code section is assembled in memory by dump_script(), as the string
+   table must be written before it */
+static unsigned char *xbuf=NULL;
+static long xlen=0,xsize=0;
+static char **xstrs=NULL; /* string table, see xstrindex() */
+static word nxstrs=0,xstrsize=0;
+static word *xhash=NULL,xhashsize=0;
+static unsigned long long *xfh=NULL; /* file hashes, see XS_HASHES */
+static word nxfh=0,xfhsize=0;
+
+static void xput(ch)
+int ch;
+{ if(xlen==xsize)
+    { xsize=xsize?2*xsize:8192;
+      xbuf=(unsigned char *)realloc(xbuf,xsize);
+      if(xbuf==NULL)mallocfail("dump buffer"); }
+  xbuf[xlen++]=ch;
 }
 
-word getword(f)
-FILE *f;
-{ int s=0, i=sizeof(word);
-  word x=getc(f);
-  while(--i)s += 8, x |= getc(f)<<s;
-  return x;
+static void xputv(x)  /* varint */
+unsigned long x;
+{ while(x>127)xput(x&127|128),x>>=7;
+  xput(x);
 }
 
-void putint(int n,FILE *f)
-{ fwrite(&n,sizeof(int),1,f); }
+static void xputz(x) /* signed varint, 0,-1,1,-2.. coded as 0,1,2,3.. */
+word x;
+{ xputv(x<0?~((unsigned long)x<<1):(unsigned long)x<<1); }
+
+static void xputdbl(x) /* assumes IEEE double, stored low order byte first */
+word x;
+{ double d=get_dbl(x);
+  unsigned long long i;
+  int k;
+  memcpy(&i,&d,sizeof(i));
+  for(k=0;k<8;k++)xput(i&255),i>>=8;
+}
 
-int getint(FILE *f)
-{ int r;
-  fread(&r,sizeof(int),1,f);
-  return r; }
+static unsigned long strhash(s)
+char *s;
+{ unsigned long h=0;
+  while(*s)h=h*31+(unsigned char)*s++;
+  return(h);
+}
 
-void putdbl(word x,FILE *f)
-{ double d = get_dbl(x);
-  fwrite(&d,sizeof(double),1,f); }
+static word xstrindex(s) /* position of s in string table, adding it if new */
+char *s;
+{ word i;
+  if(2*nxstrs>=xhashsize)
+    { word k;
+      xhashsize=xhashsize?2*xhashsize:1024;
+      xhash=(word *)realloc(xhash,xhashsize*sizeof(word));
+      if(xhash==NULL)mallocfail("dump buffer");
+      for(i=0;i<xhashsize;i++)xhash[i]= -1;
+      for(k=0;k<nxstrs;k++)
+         { i=strhash(xstrs[k])&(xhashsize-1);
+           while(xhash[i]>=0)i=(i+1)&(xhashsize-1);
+           xhash[i]=k; } }
+  i=strhash(s)&(xhashsize-1);
+  while(xhash[i]>=0&&strcmp(xstrs[xhash[i]],s))i=(i+1)&(xhashsize-1);
+  if(xhash[i]<0)
+    { if(nxstrs==xstrsize)
+        { xstrsize=xstrsize?2*xstrsize:512;
+          xstrs=(char **)realloc(xstrs,xstrsize*sizeof(char *));
+          if(xstrs==NULL)mallocfail("dump buffer"); }
+      xstrs[nxstrs]=s;
+      xhash[i]=nxstrs++; }
+  return(xhash[i]);
+}
 
-word getdbl(FILE *f)
-{ double d;
-  fread(&d,sizeof(double),1,f);
-  return sto_dbl(d);
+static void xputfile(p)  /* filename p, recording its hash */
+char *p;
+{ if(nxfh==xfhsize)
+    { xfhsize=xfhsize?2*xfhsize:64;
+      xfh=(unsigned long long *)realloc(xfh,xfhsize*sizeof(*xfh));
+      if(xfh==NULL)mallocfail("dump buffer"); }
+  xfh[nxfh++]=fm_hash(p);
+  xputv(xstrindex(mkrel(p))+1);
 }
 
+static void xput4(x,f)
+word x;
+FILE *f;
+{ putc(x&255,f),putc(x>>8&255,f),putc(x>>16&255,f),putc(x>>24&255,f); }
+
+
 static char prefix[pnlim];
 word preflen;
 
@@ -559,175 +988,413 @@ char *p;       /* must use when writing pathnames to dump */
   return(p); /* proforma only */
 }
 
-#define bits_15 0177777
 char *CFN;
 
 void dump_script(files,f) /* write compiled script files to file f */
 word files;
 FILE *f;
 { extern word ND,bereaved,errline,algshfns,internals,freeids,SGC;
-  putc(wordsize,f);
-  putc(XVERSION,f);  /* identifies dump format */
+  word i,kind=files==NIL?0:ND!=NIL?1:2;
+  long slen;
+  unsigned char n[10];
+  int nn=0;
+  xlen=nxstrs=nxfh=0;
+  for(i=0;i<xhashsize;i++)xhash[i]= -1;
+  if(kind!=2)xputv(errline);
   if(files==NIL){ /* source contains syntax or metatype error */
 		  extern word oldfiles;
 		  word x;
-		  putc(0,f);
-		  putword(errline,f);
 		  for(x=oldfiles;x!=NIL;x=tl[x])
-                     fprintf(f,"%s",mkrel(get_fil(hd[x]))),putc(0,f),
-				    /*filename*/
-                     putword(fil_time(hd[x]),f); /* mtime */
-		  return; }
-  if(ND!=NIL)putc(1,f),putword(errline,f);
-  for(;files!=NIL;files=tl[files])
-     { fprintf(f,"%s",mkrel(CFN=get_fil(hd[files]))); /* filename */
-       putc(0,f);
-       putword(fil_time(hd[files]),f);
-       putc(fil_share(hd[files]),f);
-       dump_defs(fil_defs(hd[files]),f);
-     }
- putc(0,f); /* header - not a possible filename */
- dump_defs(algshfns,f);
- if(ND==NIL&&bereaved!=NIL)dump_ob(True,f); /* special flag */
- else dump_ob(ND,f); 
- putc(DEF_X,f);
- dump_ob(SGC,f);
- putc(DEF_X,f);
- dump_ob(freeids,f);
- putc(DEF_X,f);
- dump_defs(internals,f);
-}
-
-void dump_defs(defs,f)  /* write list of defs to file f */
+                     xputfile(get_fil(hd[x])), /*filename*/
+                     xputz(fil_time(hd[x])); /* mtime */
+		  xput(0); }
+  else
+  { for(;files!=NIL;files=tl[files])
+       { xputfile(CFN=get_fil(hd[files])); /* filename */
+         xputz(fil_time(hd[files]));
+         xput(fil_share(hd[files]));
+         dump_defs(fil_defs(hd[files]));
+       }
+   xput(0); /* header - not a possible filename */
+   dump_defs(algshfns);
+   if(ND==NIL&&bereaved!=NIL)dump_ob(True); /* special flag */
+   else dump_ob(ND);
+   xput(DEF_X);
+   dump_ob(SGC);
+   xput(DEF_X);
+   dump_ob(freeids);
+   xput(DEF_X);
+   dump_defs(internals); }
+  /* now write it out, string table first */
+  for(i=nxstrs;i>127;i>>=7)n[nn++]=i&127|128;
+  n[nn++]=i;
+  for(slen=nn,i=0;i<nxstrs;i++)slen+=strlen(xstrs[i])+1;
+  putc('M',f);
+  putc('x',f);
+  putc(XVERSION,f);  /* identifies dump format */
+  putc(kind,f);
+  putc(3,f);
+  putc(XS_STRINGS,f),xput4(XHEADER,f),xput4(slen,f);
+  putc(XS_CODE,f),xput4(XHEADER+slen,f),xput4(xlen,f);
+  putc(XS_HASHES,f),xput4(XHEADER+slen+xlen,f),xput4(8*nxfh,f);
+  fwrite(n,1,nn,f);
+  for(i=0;i<nxstrs;i++)fputs(xstrs[i],f),putc(0,f);
+  fwrite(xbuf,1,xlen,f);
+  for(i=0;i<nxfh;i++)
+     { unsigned long long h=xfh[i];
+       int k;
+       for(k=0;k<8;k++)putc(h&255,f),h>>=8; }
+}
+
+void dump_defs(defs)  /* write list of defs */
 word defs;
-FILE *f;
 { while(defs!=NIL)
        if(tag[hd[defs]]==STRCONS) /* pname */
-	 { word v=get_pn(hd[defs]);
-	   dump_ob(pn_val(hd[defs]),f);
-	   if(v>bits_15)
-	     putc(PN1_X,f),
-	     putint(v,f);
-	   else
-	     putc(PN_X,f),
-	     putc(v&255,f),
-             putc(v >> 8,f);
-           putc(DEF_X,f);
+	 { dump_ob(pn_val(hd[defs]));
+	   xput(PN_X);
+	   xputv(get_pn(hd[defs]));
+           xput(DEF_X);
            defs=tl[defs]; }
        else
-       { dump_ob(id_val(hd[defs]),f);
-         dump_ob(id_type(hd[defs]),f);
-         dump_ob(id_who(hd[defs]),f);
-         putc(ID_X,f);
-         fprintf(f,"%s",(char *)get_id(hd[defs]));
-         putc(0,f);
-         putc(DEF_X,f);
+       { dump_ob(id_val(hd[defs]));
+         dump_ob(id_type(hd[defs]));
+         dump_ob(id_who(hd[defs]));
+         xput(ID_X);
+         xputv(xstrindex(get_id(hd[defs])));
+         xput(DEF_X);
          defs=tl[defs]; }
-  putc(DEF_X,f); /* delimiter */
+  xput(DEF_X); /* delimiter */
 }
 
-void dump_ob(x,f)  /* write combinatory expression x to file f */
+static word xvals=0; /* 1 while dump_ob() writes a value for send_val(),
+                        2 if it proves to contain a function */
+
+static word isval(x) /* x can be sent by send_val() */
+word x;
+{ switch(tag[x])
+  { case AP: while(tag[x]==AP)x=hd[x];
+             return(tag[x]==CONSTRUCTOR);
+    case ATOM:
+    case INT:
+    case DOUBLE:
+    case UNICODE:
+    case CONSTRUCTOR:
+    case CONS:
+    case ARRAY:
+    case HAMT: return(1);
+  }
+  return(0);
+}
+
+static void dump_spine(x,n) /* head and n args of an ap spine, see APN_X */
+word x,n;
+{ if(n==0){ dump_ob(x); return; }
+  dump_spine(hd[x],n-1);
+  dump_ob(tl[x]);
+}
+
+static void dump_list(x,n) /* n elements of a list and its tail, see LIST_X -
+                             not recursive, as a value may be a long list */
+word x,n;
+{ word *v=(word *)malloc(n*sizeof(word)),i;
+  if(v==NULL)mallocfail("dump buffer");
+  for(i=0;i<n;i++)v[i]=hd[x],x=tl[x];
+  dump_ob(x);
+  while(i--)dump_ob(v[i]);
+  free(v);
+}
+
+static word dump_entries(x) /* keys and values of the entries of a table,
+                               returns how many, see HAMT_X */
+word x;
+{ word i,n=0;
+  switch(tag[x])
+  { case PAIR: dump_ob(hd[x]);
+               dump_ob(tl[x]);
+               return(1);
+    case CONS: for(;x!=NIL;x=tl[x])n+=dump_entries(hd[x]);  /* bucket */
+               return(n);
+    case HAMT: for(i=0;i<hamtsize(x);i++)n+=dump_entries(hamtv(x)[i]);
+  }
+  return(n);
+}
+
+void dump_ob(x)  /* write combinatory expression x */
 word x;
-FILE *f;
 { /* printob("dumping: ",x); /* DEBUG */
+  if(xvals&&!isval(x)){ xvals=2; return; }
   switch(tag[x])
-  { case ATOM: if(x<128)putc(x,f); else
-               if(x>=384)putc(x-256,f); else
-               putc(CHAR_X,f),putc(x-128,f);
+  { case ATOM: if(x<128)xput(x); else
+               if(x>=384)xput(x-256); else
+               xput(CHAR_X),xput(x-128);
                return;
-    case TVAR: putc(TVAR_X,f), putc(gettvar(x),f);
-	       if(gettvar(x)>255)
-		 fprintf(stderr,"panic, tvar too large\n");
+    case TVAR: xput(TVAR_X), xputv(gettvar(x));
 	       return;
-    case INT: { word d=digit(x);
+    case INT: { word d=digit(x),n=0,y;
 		if(rest(x)==0&&(d&MAXDIGIT)<=127)
 		  { if(d&SIGNBIT)d= -(d&MAXDIGIT);
-		    putc(SHORT_X,f); putc(d,f); return; }
-		putc(INT_X,f);
-		putint(d,f);
+		    xput(SHORT_X); xput(d&255); return; }
+		for(y=x;y;y=rest(y))n++;
+		xput(INT_X);
+		xputv(n);
+		xputv((d&MAXDIGIT)<<1|(d&SIGNBIT?1:0));
 		x=rest(x);
 		while(x)
-		     putint(digit(x),f),x=rest(x);
-		putint(-1,f);
+		     xputv(digit(x)),x=rest(x);
 		return; }
-		/* 4 bytes per digit wasteful at current value of IBASE */
-    case DOUBLE: putc(DBL_X,f);
-                 putdbl(x,f);
-/*
-		 putword(hd[x],f);
-#ifdef splitdouble
-		 putword(tl[x],f);
-#endif
-*/
+    case DOUBLE: xput(DBL_X);
+                 xputdbl(x);
 		 return;
-    case UNICODE: putc(UNICODE_X,f);
-                  putint(hd[x],f);
+    case UNICODE: xput(UNICODE_X);
+                  xputv(hd[x]);
                   return;
-    case DATAPAIR: fprintf(f,"%c%s",AKA_X,(char *)hd[x]);
-	           putc(0,f);
+    case CHARSET: { word r[256],m=0,n=0,k,y=x;
+                    for(k=0;k<256;k++) /* bitmap, as ranges */
+                       if(inset(k,x))
+                         { if(m&&r[m-1]==k-1)r[m-1]=k;
+                           else r[m++]=k,r[m++]=k; }
+                    for(k=0;k<CSWORDS;k++)y=tl[y];
+                    for(k=y;k!=NIL;k=tl[k])n++;
+                    xput(CHARSET_X);
+                    xputv((m+n)/2);
+                    for(k=0;k<m;k++)xputv(r[k]);
+                    for(;y!=NIL;y=tl[y])xputv(hd[y]);
+                    return; }
+    case DATAPAIR: xput(AKA_X);
+	           xputv(xstrindex((char *)hd[x]));
 	           return;
-    case FILEINFO: { word line=tl[x];
-		     if((char *)hd[x]==CFN)putc(HERE_X,f);
-		     else fprintf(f,"%c%s",HERE_X,mkrel(hd[x]));
-		     putc(0,f);
-		     putc(line&255,f);
-		     putc((line >>= 8)&255,f);
-		     if(line>255)fprintf(stderr,
-		     "impossible line number %ld in dump_ob\n",tl[x]);
-		     return; }
-    case CONSTRUCTOR: dump_ob(tl[x],f);
-		      putc(CONSTRUCT_X,f);
-		      putc(hd[x]&255,f);
-		      putc(hd[x]>>8,f);
+    case FILEINFO: xput(HERE_X);
+		   if((char *)hd[x]==CFN)xput(0);
+		   else xputv(xstrindex(mkrel((char *)hd[x]))+1);
+		   xputv(tl[x]);
+		   return;
+    case CONSTRUCTOR: if(xvals){ xput(CONSTRUCT_X); xputv(x); return; }
+		      dump_ob(tl[x]);
+		      xput(CONSTRUCT_X);
+		      xputv(hd[x]);
 		      return;
-    case STARTREADVALS: dump_ob(tl[x],f);
-			putc(RV_X,f);
+    case STARTREADVALS: dump_ob(tl[x]);
+			xput(RV_X);
 			return;
-    case ID: fprintf(f,"%c%s",ID_X,get_id(x));
-	     putc(0,f);
-	     return;
-    case STRCONS: { word v=get_pn(x); /* private name */
-	            if(v>bits_15)
-	              putc(PN1_X,f),
-	              putint(v,f);
-	            else
-		      putc(PN_X,f),
-		      putc(v&255,f),
-		      putc(v >> 8,f);
-		    return; }
-    case AP: dump_ob(hd[x],f);
-	     dump_ob(tl[x],f);
-	     putc(AP_X,f);
+    case ID: xput(ID_X);
+	     xputv(xstrindex(get_id(x)));
 	     return;
-    case CONS: dump_ob(tl[x],f);
-	       dump_ob(hd[x],f);
-	       putc(CONS_X,f);
-	       return;
+    case STRCONS: xput(PN_X); /* private name */
+	          xputv(get_pn(x));
+		  return;
+    case AP: { word n=0,y;
+	       for(y=x;tag[y]==AP;y=hd[y])n++;
+	       if(n==1)
+	         { dump_ob(hd[x]);
+	           dump_ob(tl[x]);
+	           xput(AP_X);
+	           return; }
+	       dump_spine(x,n);
+	       xput(APN_X);
+	       xputv(n);
+	       return; }
+    case CONS: { word n=0,y;
+		 for(y=x;tag[y]==CONS;y=tl[y])n++;
+		 if(n==1)
+		   { dump_ob(tl[x]);
+		     dump_ob(hd[x]);
+		     xput(CONS_X);
+		     return; }
+		 dump_list(x,n);
+		 xput(LIST_X);
+		 xputv(n);
+		 return; }
+    case ARRAY: { word i;
+                  for(i=0;i<tl[x];i++)dump_ob(arrayv(x)[i]);
+                  xput(ARRAY_X);
+                  xputv(tl[x]);
+                  return; }
+    case HAMT: { word n=dump_entries(x);
+                 xput(HAMT_X);
+                 xputv(n);
+                 return; }
     default: fprintf(stderr,"impossible tag %d in dump_ob\n",tag[x]);
     }
 }
 
 #define ovflocheck if(dicq-dic>DICSPACE)dicovflo()
-extern char *dic; extern word DICSPACE;
+extern char *dic,*dicp,*dicq; extern word DICSPACE;
 
 word BAD_DUMP=0,CLASHES=NIL,ALIASES=NIL,PNBASE=0,SUPPRESSED=NIL,
     TSUPPRESSED=NIL,TORPHANS=0;
 
+/* a dump is read by mapping the whole file into memory, see xopen() */
+static unsigned char *xmap,*xp,*xend; /* xp, xend delimit code remaining */
+static size_t xmaplen;
+static word xkind,xeof;
+static unsigned char *xfhs; /* XS_HASHES, if present */
+static word nxfhs;
+static char **xs;    /* string table, xs[nxs] is "" for bad indices */
+static word nxs;
+static word *xsid;   /* caches, of name() of each string */
+static char **xsfil; /* and of each string as a pathname, see xfil() */
+
+#define xget() (xp<xend?*xp++:(xeof=1,EOF))
+
+static unsigned long xgetv()  /* varint */
+{ unsigned long x=0;
+  int s=0,ch;
+  do{ if((ch=xget())==EOF)return(0);
+      x|=(unsigned long)(ch&127)<<s;
+      s+=7; } while(ch&128);
+  return(x);
+}
+
+static word xgetz()  /* signed varint, see xputz */
+{ unsigned long x=xgetv();
+  return(x&1?~(word)(x>>1):(word)(x>>1));
+}
+
+static word xgetdbl()
+{ unsigned long long i=0;
+  double d;
+  int k;
+  for(k=0;k<64;k+=8)i|=(unsigned long long)(xget()&255)<<k;
+  memcpy(&d,&i,sizeof(d));
+  return(sto_dbl(d));
+}
+
+static word xindex(n)  /* string index, checked */
+unsigned long n;
+{ if(n<nxs)return(n);
+  BAD_DUMP=5; xp=xend;
+  return(nxs);
+}
+
+static unsigned long xget4(p)
+unsigned char *p;
+{ return(p[0]|p[1]<<8|p[2]<<16|(unsigned long)p[3]<<24); }
+
+static int xopen(f)  /* map dump f and locate its sections, 0 if not a dump */
+FILE *f;
+{ struct stat buf;
+  unsigned char *p,*q,*e,*cp,*ce;
+  word k,nsect;
+  xs=NULL,xsid=NULL,xsfil=NULL;
+  nxfhs=0;
+  if(fstat(fileno(f),&buf)==-1||buf.st_size<XHEADER)return(0);
+  xmaplen=buf.st_size;
+  xmap=mmap(NULL,xmaplen,PROT_READ,MAP_PRIVATE,fileno(f),0);
+  if(xmap==(unsigned char *)MAP_FAILED)return(0);
+  if(xmap[0]!='M'||xmap[1]!='x'||xmap[2]!=XVERSION||(xkind=xmap[3])>2)
+    { munmap(xmap,xmaplen); return(0); }
+  nsect=xmap[4];
+  cp=ce=NULL;
+  nxs= -1;
+  if(5+9*nsect>xmaplen){ munmap(xmap,xmaplen); return(0); }
+  for(k=0;k<nsect;k++)
+     { unsigned long off=xget4(xmap+6+9*k),len=xget4(xmap+10+9*k);
+       if(off>xmaplen||len>xmaplen-off)continue;
+       p=xmap+off,e=p+len;
+       switch(xmap[5+9*k])
+       { case XS_CODE: cp=p,ce=e;
+		       continue;
+         case XS_HASHES: xfhs=p,nxfhs=len/8;
+		         continue;
+         case XS_STRINGS: { word n;
+			    xp=p,xend=e;
+			    n=xgetv();
+			    if(n>len||xs)break; /* surely corrupt */
+			    xs=(char **)malloc((n+1)*sizeof(char *));
+			    xsid=(word *)calloc(n+1,sizeof(word));
+			    xsfil=(char **)calloc(n+1,sizeof(char *));
+			    if(xs==NULL||xsid==NULL||xsfil==NULL)
+			      mallocfail("dump strings");
+			    for(q=xp,nxs=0;nxs<n&&q<e;q++)
+			       { xs[nxs++]=(char *)q;
+			         while(q<e&&*q)q++; }
+			    if(nxs!=n||q!=e)break;
+			    xs[nxs]="";
+			    continue; }
+         default: continue; /* unknown sections are ignored */
+       }
+       nxs= -1; /* bad string table */
+       break; }
+  if(nxs<0||cp==NULL)
+    { free(xs),free(xsid),free(xsfil);
+      munmap(xmap,xmaplen);
+      return(0); }
+  xp=cp,xend=ce;
+  xeof=0;
+  return(1);
+}
+
+static void xclose()
+{ free(xs),free(xsid),free(xsfil);
+  munmap(xmap,xmaplen);
+}
+
+word XTOUCHED=0; /* set if a file was taken to be unchanged by its hash, so
+                    the dump should be made again to record its new mtime */
+
+static word xfresh(k,t)  /* mtime for k'th file of dump, recorded as t */
+word k,t;                /* pathname is at dicp */
+{ unsigned long long h=0;
+  word now=fm_time(dicp),i;
+  if(k>=nxfhs||t==now)return(t);
+  for(i=7;i>=0;i--)h=h<<8|xfhs[8*k+i];
+  if(h&&h==fm_hash(dicp)){ XTOUCHED=1; return(now); }
+  return(t);
+}
+
+static word xid(i)  /* the identifier whose name is string i */
+word i;
+{ if(!xsid[i])
+    { dicq=dicp+strlen(xs[i])+1;
+      ovflocheck;
+      (void)strcpy(dicp,xs[i]);
+      xsid[i]=name(); /* see lex.c */ }
+  return(xsid[i]);
+}
+
+static char *xpath(i)  /* string i as a pathname, placed at dicp */
+word i;
+{ char *s=xs[i],*d;
+  dicq=dicp;
+  if(*s!='/')(void)strcpy(dicp,prefix),dicq+=preflen;
+	     /* locate wrt current posn */
+  d=dicq;
+  dicq+=strlen(s)+1;
+  ovflocheck;
+  (void)strcpy(d,s);
+  return(dicp);
+}
+
+static char *xfil(i)  /* shared copy of string i as a pathname */
+word i;
+{ if(!xsfil[i])(void)xpath(i),xsfil[i]=get_id(name());
+  return(xsfil[i]);
+}
+
 word load_script(f,src,aliases,params,main)
 	     /* loads a compiled script from file f for source src */
 	     /* main=1 if is being loaded as main script, 0 otherwise */
 FILE *f;
 char *src;
 word aliases,params,main;
-{ extern word nextpn,ND,errline,algshfns,internals,freeids,includees,SGC;
-  extern char *dicp, *dicq;
-  word ch,files=NIL;
-  TORPHANS=BAD_DUMP=0;
+{ word files;
+  TORPHANS=BAD_DUMP=XTOUCHED=0;
   CLASHES=NIL;
   dsetup();
   setprefix(src);
-  if(getc(f)!= wordsize || getc(f)!=XVERSION)
+  if(!xopen(f))
     { BAD_DUMP= -1; return(NIL); }
+  files=load_files(src,aliases,params,main);
+  xclose();
+  return(files);
+}
+
+static word load_files(src,aliases,params,main) /* body of load_script */
+char *src;
+word aliases,params,main;
+{ extern word nextpn,ND,errline,algshfns,internals,freeids,includees,SGC;
+  extern char *dicp, *dicq;
+  word ch,files=NIL,k=0;
   if(aliases!=NIL)
     { /* for each `old' install diversion to `new' */
       /* if alias is of form -old `new' is a pname */
@@ -753,19 +1420,15 @@ word aliases,params,main;
   PNBASE=nextpn;  /* base for relocation of internal names in dump */
   SUPPRESSED=NIL; /* list of `-id' aliases successfully obeyed */
   TSUPPRESSED=NIL;  /* list of -typename aliases (illegal just now) */
-  while((ch=getc(f))!=0&&ch!=EOF&&!BAD_DUMP)
-       { word s,holde=0;
-	 dicq=dicp;
-	 if(files==NIL&&ch==1) /* type error script */
-           { holde=getword(f),ch=getc(f);
-	     if(main)errline=holde; }
-	 if(ch!='/')(void)strcpy(dicp,prefix),dicq+=preflen;
-		   /* locate wrt current posn */
-         *dicq++ = ch;
-         while((*dicq++ =ch=getc(f))&&ch!=EOF); /* filename */
-	 ovflocheck;
-         ch=getword(f); /* mtime */
-	 s=getc(f); /* share bit */
+  if(xkind!=2) /* syntax or type error script */
+    { ch=xgetv();
+      if(main)errline=ch; }
+  if(xkind!=0)
+  while((ch=xgetv())!=0&&!BAD_DUMP)
+       { word s;
+	 (void)xpath(xindex(ch-1)); /* filename */
+         ch=xfresh(k++,xgetz()); /* mtime */
+	 s=xget(); /* share bit */
          /*printf("loading: %s(%d)\n",dicp,ch); /* DEBUG */
 	 if(files==NIL) /* is this the right dump? */
 	 if(strcmp(dicp,src))
@@ -773,30 +1436,24 @@ word aliases,params,main;
 	     if(aliases!=NIL)unscramble(aliases);
 	     return(NIL); }
 	 CFN=get_id(name()); /* wasteful way to share filename */
-         files = cons(make_fil(CFN,ch,s,load_defs(f)),
+         files = cons(make_fil(CFN,ch,s,load_defs()),
 		      files);
        }
-/* warning: load_defs side effects id's in namebuckets, cannot  be  undone  by
+/* warning: load_defs side effects id's in idtab, cannot  be  undone  by
 unload  until  attached  to  global `files', so interrupts are disabled during
 load_script - see steer.c */ /* for big dumps this may be too coarse - FIX */
-  if(ch==EOF||BAD_DUMP){ if(!BAD_DUMP)BAD_DUMP=2; 
+  if(xeof||BAD_DUMP||xkind!=0&&files==NIL)
+		       { if(!BAD_DUMP)BAD_DUMP=2;
 	                 if(aliases!=NIL)unscramble(aliases);
 	                 return(files); }
   if(files==NIL){ /* dump of syntax error state */
 		  extern word oldfiles;
-		  ch=getword(f);
-		  if(main)errline=ch;
-                  while((ch=getc(f))!=EOF)
-                       { dicq=dicp;
-	                 if(ch!='/')(void)strcpy(dicp,prefix),dicq+=preflen;
-		                   /* locate wrt current posn */
-                         *dicq++ = ch;
-                         while((*dicq++ =ch=getc(f))&&ch!=EOF); /* filename */
-			 ovflocheck;
-                         ch=getword(f); /* mtime */
+                  while((ch=xgetv())!=0)
+                       { (void)xpath(xindex(ch-1)); /* filename */
+                         ch=xfresh(k++,xgetz()); /* mtime */
 	                 if(oldfiles==NIL) /* is this the right dump? */
 	                 if(strcmp(dicp,src))
-	                   { BAD_DUMP=1; 
+	                   { BAD_DUMP=1;
 	                     if(aliases!=NIL)unscramble(aliases);
 			     return(NIL); }
                          oldfiles = cons(make_fil(get_id(name()),ch,0,NIL),
@@ -804,14 +1461,14 @@ load_script - see steer.c */ /* for big dumps this may be too coarse - FIX */
 		       }
 	          if(aliases!=NIL)unscramble(aliases);
 		  return(NIL); }
-  algshfns=append1(algshfns,load_defs(f));
-  ND=load_defs(f);
+  algshfns=append1(algshfns,load_defs());
+  ND=load_defs();
   if(ND==True)ND=NIL,TORPHANS=1;
-  SGC=append1(SGC,load_defs(f));
-  if(main||includees==NIL)freeids=load_defs(f);
-  else bindparams(load_defs(f),hdsort(params));
+  SGC=append1(SGC,load_defs());
+  if(main||includees==NIL)freeids=load_defs();
+  else bindparams(load_defs(),hdsort(params));
   if(aliases!=NIL)unscramble(aliases);
-  if(main)internals=load_defs(f);
+  if(main)internals=load_defs();
   return(reverse(files));
 }/* was it necessary to unscramble aliases before error returns?
     check this later */
@@ -908,90 +1565,81 @@ void dgrow()
   /*printf("dsize=%d\n",dlim-dstack);  /* DEBUG */
 }
 
-word load_defs(f)  /* load a sequence of definitions from file f, terminated
-		 by DEF_X, or a single object terminated by DEF_X */
-FILE *f;
+word load_defs()  /* load a sequence of definitions, terminated by DEF_X, or a
+		     single object terminated by DEF_X */
 { extern char *dicp, *dicq;
   extern word *pnvec,common_stdin,common_stdinb,nextpn,rv_script;
   word ch, defs=NIL;
-  while((ch=getc(f))!=EOF)
+  while((ch=xget())!=EOF)
   { if(stackp==dlim)dgrow();
     switch(ch)
-    { case CHAR_X: *stackp++ = getc(f)+128;
+    { case CHAR_X: *stackp++ = xget()+128;
 		   continue;
-      case TVAR_X: *stackp++ = mktvar(getc(f));
+      case TVAR_X: *stackp++ = mktvar(xgetv());
 		   continue;
-      case SHORT_X: ch = getc(f);
+      case SHORT_X: ch = xget();
 		    if(ch&128)ch= ch|(~127); /*force a sign extension*/
 		    *stackp++ = stosmallint(ch);
 		    continue;
-      case INT_X: { word *x;
-		    ch = getint(f);
-		    *stackp++ = make(INT,ch,0);
+      case INT_X: { word *x,n=xgetv();
+		    ch = xgetv();
+		    *stackp++ = make(INT,ch>>1|(ch&1?SIGNBIT:0),0);
 		    x = &rest(stackp[-1]);
-		    ch = getint(f);
-		    while(ch!= -1)
-			 *x=make(INT,ch,0),ch=getint(f),x= &rest(*x);
+		    while(--n>0)
+			 *x=make(INT,xgetv(),0),x= &rest(*x);
 		    continue; }
-      case DBL_X: *stackp++ = getdbl(f);
-/*
-#ifdef splitdouble
-		  *stackp++ = make(DOUBLE,ch,getword(f));
-#else
-                  *stackp++ = make(DOUBLE,ch,0);
-#endif
-*/
+      case DBL_X: *stackp++ = xgetdbl();
 		  continue;
-      case UNICODE_X: *stackp++ = make(UNICODE,getint(f),0);
+      case UNICODE_X: *stackp++ = make(UNICODE,xgetv(),0);
                       continue;
-      case PN_X: ch = getc(f);
-		 ch = PNBASE+(ch|(getc(f)<<8));
+      case ARRAY_X: { word n=xgetv(),a,i;
+                      if(n>stackp-dstack){ BAD_DUMP=6; return(defs); }
+                      a=mkarray(n);
+                      stackp-=n;
+                      for(i=0;i<n;i++)arrayv(a)[i]=stackp[i];
+                      tl[a]=n;
+                      *stackp++ = a;
+                      continue; }
+      case HAMT_X: { word n=xgetv(),x=NIL,*p;
+                     if(2*n>stackp-dstack){ BAD_DUMP=6; return(defs); }
+                     for(p=stackp;p>stackp-2*n;p-=2)x=cons(cons(p[-2],p[-1]),x);
+                     x=listtable(x);
+                     stackp-=2*n;
+                     *stackp++ = x;
+                     continue; }
+      case CHARSET_X: { word n=xgetv(),*r,i;
+                        r=(word *)malloc((2*n+2)*sizeof(word));
+                        if(r==NULL)mallocfail("charset");
+                        for(i=0;i<2*n;i++)r[i]=xgetv();
+                        *stackp++ = mkcharset(r,n,0);
+                        free(r);
+                        continue; }
+      case PN_X: ch = PNBASE+xgetv();
 		 *stackp++ = ch<nextpn?pnvec[ch]:sto_pn(ch);
 		 /* efficiency hack for *stackp++ = sto_pn(ch); */
 		 continue;
-      case PN1_X: ch=PNBASE+getint(f);
-		  *stackp++ = ch<nextpn?pnvec[ch]:sto_pn(ch);
-		  /* efficiency hack for *stackp++ = sto_pn(ch); */
-		  continue;
-      case CONSTRUCT_X: ch = getc(f);
-		        ch = ch|(getc(f)<<8);
+      case CONSTRUCT_X: ch = xgetv();
+			if(xvals){ *stackp++ = ch; continue; } /* see send_val */
 	                stackp[-1] = constructor(ch,stackp[-1]);
 		        continue;
       case RV_X: stackp[-1] = readvals(0,stackp[-1]);
 		 rv_script=1;
 		 continue;
-      case ID_X: dicq=dicp;
-                 while((*dicq++ =ch=getc(f))&&ch!=EOF);
-		 ovflocheck;
-	         *stackp++=name(); /* see lex.c */
+      case ID_X: *stackp++=xid(xindex(xgetv()));
 		 if(id_type(stackp[-1])==new_t) /* FIX1 (& next 2 lines) */
 		   CLASHES=add1(stackp[-1],CLASHES),stackp[-1]=NIL;
 		 else
 		 if(id_type(stackp[-1])==alias_t) /* follow alias */
 		   stackp[-1]=id_val(stackp[-1]);
 	         continue;
-      case AKA_X: dicq=dicp;
-		  while((*dicq++ =ch=getc(f))&&ch!=EOF);
-		  ovflocheck;
-	          *stackp++=datapair(get_id(name()),0);
-			    /* wasteful, to share string */
+      case AKA_X: *stackp++=datapair(get_id(xid(xindex(xgetv()))),0);
+			    /* to share string */
 	          continue;
-      case HERE_X: dicq=dicp;
-                   ch=getc(f);
-		   if(!ch){ /* coding hack, 0 means current file name */
-			    ch = getc(f);
-		            ch = ch|getc(f)<<8;
-	                    *stackp++ = fileinfo(CFN,ch);
-			    continue; }
-		   /* next line locates wrt current posn */
-		   if(ch!='/')(void)strcpy(dicp,prefix),dicq+=preflen;
-		   *dicq++ = ch;
-                   while((*dicq++ =ch=getc(f))&&ch!=EOF);
-		   ovflocheck;
-		   ch = getc(f);
-		   ch = ch|getc(f)<<8;
-	           *stackp++ = fileinfo(get_id(name()),ch); /* wasteful */
-		   continue;
+      case HERE_X: { char *fn;
+		     ch=xgetv();
+		     fn= ch?xfil(xindex(ch-1)):CFN; /* 0 means current file */
+	             *stackp++ = fileinfo(fn,xgetv());
+		     continue; }
       case DEF_X: switch(stackp-dstack){
 		  case 0: /* defs delimiter */
 		    { /*printlist("contents: ",defs); /* DEBUG */
@@ -1082,52 +1730,152 @@ FILE *f;
 		 if(stackp[-1]==READBIN&&ch==0)stackp[-1] = common_stdinb; else
 	         stackp[-1] = ap(stackp[-1],ch);
 	         continue;
+      case APN_X: { word *p,r;
+		    ch = xgetv();
+		    if(ch>=stackp-dstack){ BAD_DUMP=6; return(defs); }
+		    p = stackp-ch;
+		    r = p[-1];
+		    if(r==READ&&*p==0)r=common_stdin,p++; else
+		    if(r==READBIN&&*p==0)r=common_stdinb,p++;
+		    for(;p<stackp;p++)r=ap(r,*p);
+		    stackp -= ch;
+		    stackp[-1] = r;
+		    continue; }
       case CONS_X: ch = *--stackp;
 	           stackp[-1] = cons(ch,stackp[-1]);
 	           continue;
+      case LIST_X: { word *p,r;
+		     ch = xgetv();
+		     if(ch>=stackp-dstack){ BAD_DUMP=6; return(defs); }
+		     r = stackp[-ch-1];
+		     for(p=stackp-ch;p<stackp;p++)r=cons(*p,r);
+		     stackp -= ch;
+		     stackp[-1] = r;
+		     continue; }
       default: *stackp++ = ch>127?ch+256:ch;
     }}
   BAD_DUMP=4; /* should unsetids */
   return(defs);
 }
 
+/* values are sent between processes forked from one another, see spark()
+   in reduce.c, as the code of a dump written by dump_ob() and read by
+   load_defs() with xvals set.  As each heap is a copy of that of their
+   common parent, a constructor is sent as CONSTRUCT_X and the address of
+   its cell, without its id.  Only a value evaluated completely and free of
+   functions can be sent.  Each is preceded by its length, in 8 bytes low
+   order first, so that a pipe can carry a stream of them - length 0 means
+   that the sender has no value to send, see send_none(). */
+
+word send_val(fd,x) /* returns 0, sending nothing, if x cannot be sent */
+int fd;
+word x;
+{ long n=0,k;
+  xlen=0,xvals=1;
+  for(k=0;k<8;k++)xput(0); /* room for the length */
+  dump_ob(x);
+  xput(DEF_X);
+  if(xvals==2)return(xvals=0);
+  xvals=0;
+  for(n=xlen-8,k=0;k<8;k++)xbuf[k]=n&255,n>>=8;
+  while(n<xlen&&(k=write(fd,xbuf+n,xlen-n))>0)n+=k;
+  return(n==xlen);
+}
+
+void send_none(fd)
+int fd;
+{ static unsigned char none[8];
+  (void)write(fd,none,8);
+}
+
+static long readall(fd,buf,n) /* n bytes from fd, or as many as there are */
+int fd;
+unsigned char *buf;
+long n;
+{ long m=0,k;
+  while(m<n)
+       if((k=read(fd,buf+m,n-m))>0)m+=k; else
+       if(k==0||errno!=EINTR)break;
+  return(m);
+}
+
+word recv_val(fd,v) /* the next value sent down fd, in *v - returns 1, or 0
+                       if the sender had none, -1 if it has gone away */
+int fd;
+word *v;
+{ unsigned char h[8],*buf;
+  long n=0,k;
+  word bad=BAD_DUMP;
+  if(readall(fd,h,8)<8)return(-1);
+  for(k=8;k--;)n=n<<8|h[k];
+  if(n==0)return(0);
+  buf=(unsigned char *)malloc(n);
+  if(buf==NULL)mallocfail("value buffer");
+  if(readall(fd,buf,n)<n){ free(buf); return(-1); }
+  xp=buf,xend=buf+n,xvals=1,BAD_DUMP=0;
+  dsetup();
+  *v=load_defs();
+  k=BAD_DUMP==0&&xp==xend?1:-1;
+  xvals=0,BAD_DUMP=bad;
+  stackp=dstack;
+  free(buf);
+  return(k);
+}
+
 extern char *obsuffix;
 
+int samesource(t) /* return 1 if the dump of script t records the hash its
+                     source has now, see xfresh() */
+char *t;
+{ char obf[120];
+  unsigned long long h=0;
+  FILE *f;
+  word i;
+  (void)strcpy(obf,t);
+  (void)strcpy(obf+strlen(obf)-1,obsuffix);
+  if(!(f=fopen(obf,"r")))return(0);
+  if(!xopen(f)){ fclose(f); return(0); }
+  fclose(f);
+  if(nxfhs>0)for(i=7;i>=0;i--)h=h<<8|xfhs[i]; /* the first file is t */
+  xclose();
+  return(h&&h==fm_hash(t));
+}
+
 int okdump(t) /* return 1 if script t has a non-syntax-error dump */
 char *t;
 { char obf[120];
   FILE *f;
+  int r;
   (void)strcpy(obf,t);
   (void)strcpy(obf+strlen(obf)-1,obsuffix);
-  f=fopen(obf,"r");
-  if(f&&getc(f)==XVERSION&&getc(f)){fclose(f); return(1); }
-  return(0);
+  if(!(f=fopen(obf,"r")))return(0);
+  r=xopen(f)?(xclose(),xkind!=0):0;
+  fclose(f);
+  return(r);
 }
 
 word geterrlin(t) /* returns errline from dump of t if relevant, 0 otherwise */
 char *t;
 { char obf[120];
   extern char *dicp,*dicq;
-  int ch; word el;
+  word ch,el=0,bad=BAD_DUMP;
   FILE *f;
   (void)strcpy(obf,t);
   (void)strcpy(obf+strlen(obf)-1,obsuffix);
   if(!(f=fopen(obf,"r")))return(0);
-  if(getc(f)!=XVERSION||(ch=getc(f))&&ch!=1){ fclose(f);
-                                              return(0); }
-  el=getword(f);
-  /* now check this is right dump */
-  setprefix(t);
-  ch=getc(f);
-  dicq=dicp;
-  if(ch!='/')(void)strcpy(dicp,prefix),dicq+=preflen;
-            /* locate wrt current posn */
-  *dicq++ = ch;
-  while((*dicq++ =ch=getc(f))&&ch!=EOF); /* filename */
-  ch=getword(f); /* mtime */
-  if(strcmp(dicp,t)||ch!=fm_time(t))return(0); /* wrong dump */
+  if(!xopen(f)){ fclose(f); return(0); }
+  fclose(f);
+  if(xkind!=2)
+    { el=xgetv();
+      /* now check this is right dump */
+      setprefix(t);
+      (void)xpath(xindex(xgetv()-1)); /* filename */
+      ch=xgetz(); /* mtime */
+      if(BAD_DUMP!=bad||strcmp(dicp,t)||ch!=fm_time(t))el=0; /* wrong dump */
+      BAD_DUMP=bad; } /* not the dump being loaded, see xindex */
   /* this test not foolproof, strictly should extract all files and check
      their mtimes, as in undump, but this involves reading the whole dump */
+  xclose();
   return(el);
 }
 
@@ -1247,6 +1995,15 @@ word x;
   if(tag[x]==ID){ fprintf(f,"%s",get_id(x)); return; }
   if(x<256){ fprintf(f,"\'%s\'",charname(x)); return; }
   if(tag[x]==UNICODE){ fprintf(f,"'\%lx'",hd[x]); return; }
+  if(tag[x]==CHARSET){ fprintf(f,"CHARSET"); return; }
+  if(tag[x]==HAMT){ fprintf(f,"HAMT"); return; }
+  if(tag[x]==ARRAY)
+    { word i;
+      fprintf(f,"ARRAY(");
+      for(i=0;i<tl[x];i++)
+         { if(i)putc(',',f);
+           out(f,arrayv(x)[i]); }
+      putc(')',f); return; }
   if(tag[x]==ATOM)
     { fprintf(f,"%s",x<CMBASE?yysterm[x-256]:
 		     x==True?"True":
@@ -53,24 +53,33 @@ extern YYSTYPE yylval;
    to current directory on dump/undump */
 #define TVAR 4
 #define INT 5
-#define CONSTRUCTOR 6
-#define STRCONS 7
-#define ID 8
-#define AP 9
-#define LAMBDA 10
-#define CONS 11
-#define TRIES 12
-#define LABEL 13
-#define SHOW 14
-#define STARTREADVALS 15
-#define LET 16
-#define LETREC 17
-#define SHARE 18
-#define LEXER 19
-#define PAIR 20
-#define UNICODE 21
-#define TCONS 22
-     /*  ATOM ... TCONS  are the possible values of the
+#define CHARSET 6
+/* CHARSET is a %lex character class, a chain of cells with a bitmap word
+   in hd, see charset() in data.c */
+#define CONSTRUCTOR 7
+#define STRCONS 8
+#define ID 9
+#define AP 10
+#define LAMBDA 11
+#define CONS 12
+#define TRIES 13
+#define LABEL 14
+#define SHOW 15
+#define STARTREADVALS 16
+#define LET 17
+#define LETREC 18
+#define SHARE 19
+#define LEXER 20
+#define PAIR 21
+#define UNICODE 22
+#define TCONS 23
+#define ARRAY 24
+/* ARRAY has in hd a malloc'd vector of heap objects and in tl its length,
+   see mkarray() in data.c */
+#define HAMT 25
+/* HAMT is a node of a table, with in hd a malloc'd vector like an ARRAY's
+   and in tl a bitmap of the slots it fills, see mkhamt() in data.c */
+     /*  ATOM ... HAMT  are the possible values of the
          "tag" field of a cell  */
 
 #define TOP (SPACE+ATOMLIMIT)
@@ -80,6 +89,11 @@ extern YYSTYPE yylval;
 #define tlptrbit BACKSTOP
 #define tlptrbits (3l<<(__WORDSIZE-2))
 
+#define CSWORDS (256/__WORDSIZE) /* bitmap words of a CHARSET */
+#define arrayv(a) ((word *)hd[a]) /* elements of an ARRAY */
+#define hamtv(t) ((word *)hd[t]) /* contents of the slots of a HAMT node */
+#define hamtsize(t) __builtin_popcountl(tl[t]) /* number of them */
+
 #define datapair(x,y) make(DATAPAIR,(word)x,(word)y)
 #define fileinfo(x,y) make(FILEINFO,(word)x,(word)y)
 #define constructor(n,x) make(CONSTRUCTOR,(word)n,(word)x)
@@ -209,12 +223,11 @@ Applying bind_t to a type variable, thus: ap(bind_t,tv), indicates that
 it is not to be instantiated. Applying strict_t to a type represents the
 '!' operator of algebraic type definitions.
 */
-#define hashsize 512
-/* size of hash table for unification algorithm in typechecker */
-#define mktvar(i) make(TVAR,0,i)
+#define mktvar(i) make(TVAR,-1,i)
+/* hd of a type variable is its binding, or negative if unbound - see prune()
+   in types.c */
 #define gettvar(x) (tl[x])
 #define eqtvar(x,y) (tl[x]==tl[y])
-#define hashval(x)  (gettvar(x)%hashsize)
 /* NB perhaps slightly wasteful to allocate a cell for each tvar,
 could be fixed by having unboxed repn for small integers */
 
@@ -240,6 +253,7 @@ cons(cons(arity,showfn),cons(free_t,NIL))
 /* function prototypes - data.c */
 word append1(word,word);
 char *charname(word);
+word charset(word,word);
 void dump_script(word,FILE *);
 void gc(void);
 void gcpatch(void);
@@ -247,17 +261,26 @@ char *getaka(word);
 word get_char(word);
 word geterrlin(char *);
 word get_here(word);
+int inset(word,word);
 int is_char(word);
 word load_script(FILE *,char *,word,word,word);
 word make(unsigned char,word,word);
 void mallocfail(char *);
+void mark(word);
+word mkarray(word);
+word mkhamt(word);
+char *mkrel(char *);
 int okdump(char *);
+int samesource(char *);
 void out(FILE *,word);
 void out1(FILE *,word);
 void out2(FILE *,word);
 void outr(FILE *,double);
+word recv_val(int,word *);
 void resetgcstats(void);
 void resetheap(void);
+word send_val(int,word);
+void send_none(int);
 void setdbl(word,double);
 void setprefix(char *);
 void setupheap(void);
@@ -269,10 +292,15 @@ word trueheapsize(void);
 /* function prototypes - reduce.c */
 word head(word);
 void initclock(void);
+word listtable(word);
 void math_error(char *);
+void memo_mark(void);
 void out_here(FILE *,word,word);
 void output(word);
 void outstats(void);
+void resetstats(void);
+void sort_reset(void);
+void spark_reap(void);
 
 /* function prototypes - trans.c */
 word block(word,word,word);
@@ -302,9 +330,11 @@ void acterror(void);
 word alfasort(word);
 void dieclean(void);
 word fixtype(word,word);
+unsigned long long fm_hash(const char *);
 word fm_time(const char *);  /* assumes type word same size as time_t */
 void fpe_error(void);
 word parseline(word,FILE *,word);
+word pool_eval(void);
 word process(void);
 void readoption(void);
 void reset(void);
@@ -312,11 +342,14 @@ word reverse(word);
 word shunt(word,word);
 word size(word);
 void syntax(const char *);
+void tstart(void);
+void tstop(const char *,const char *);
 void yyerror(const char *);
 
 /* function prototypes - types.c */
 word add1(word,word);
 void checktypes(void);
+void tw_stop(void);
 word deps(word);
 word genlstat_t(void);
 word instantiate(word);
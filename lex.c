@@ -47,14 +47,19 @@ word commandmode;
 word common_stdin,common_stdinb,cook_stdin;
 word litmain=0,literate=0; /* flags "literate" comment convention */
 char *dic,*dicp,*dicq;
+word dicold=0; /* chars used in earlier blocks of the dictionary */
+word *idtab,idtabsize,nids=0;
+/* identifiers, by open hashing on their names - empty slots are 0 */
 char *pathname();
 
 void setupdic()
 { dicp=dicq=dic=malloc(DICSPACE);
   if(dic==NULL)mallocfail("dictionary");
-  /* it is not permissible to realloc dic, because at the moment identifiers
-     etc. contain absolute pointers into the dictionary space - so we must
-     choose fairly large initial value for DICSPACE.  Fix this later */
+  /* it is not permissible to realloc dic, because identifiers etc. contain
+     absolute pointers into the dictionary space - so when it is nearly full
+     we go on in a new block of DICSPACE chars, see dic_check() */
+  idtab=(word *)calloc(idtabsize=1024,sizeof(word));
+  if(idtab==NULL)mallocfail("name table");
   prefixbase=malloc(prefixlimit);
   prefixbase[0]='\0';
   prefix=0;
@@ -84,6 +89,7 @@ char *n;
 
 void dicovflo() /* is this called everywhere it should be? Check later */
 { fprintf(stderr,"\npanic: dictionary overflow\n"); exit(1); }
+/* now only a single string of more than DICSPACE/4 chars can cause this */
 
 char *token() /* lex analyser for command language (very simple) */
 { extern char *current_script;
@@ -600,7 +606,7 @@ word i;
 	 p= &tl[*p]; }
   if(*p==NIL)*p=cons(sto_id("gvar"),NIL);
   return(hd[*p]);
-} /* all these variables have the same name, and are not in hashbucket */
+} /* all these variables have the same name, and are not in idtab */
 
 word lexvar=0;
 
@@ -904,13 +910,20 @@ char *p;
 { if(p==dicp)dicp= dicq;
   else (void)strcpy(dicp,p),
        p=dicp,
-       dicp=dicq=dicp+strlen(dicp)+1,
-       dic_check();
+       dicp=dicq=dicp+strlen(dicp)+1;
+  dic_check();
   return(p);
 }  
 
-void dic_check()  /* called from REDUCE */
-{ ovflocheck; }
+void dic_check()  /* called after dicp is advanced */
+{ ovflocheck;
+  if(dicq==dicp&&dicq-dic>DICSPACE-DICSPACE/4)
+    { /* leave room for volatile strings - start a new block, the old one
+	 stays where it is as its strings are still in use */
+      dicold+=dicp-dic;
+      dicp=dicq=dic=malloc(DICSPACE);
+      if(dic==NULL)mallocfail("dictionary"); }
+}
 
 void numeral()
 { word nflag=1;
@@ -995,15 +1008,45 @@ void octnumeral()   /* added 21.11.2013 */
   yylval= bigoscan(dicp,dicq);
 }
 
-word namebucket[128]; /* each namebucket has a list terminated by 0, not NIL */
+static unsigned long namehash(s)  /* FNV-1a */
+char *s;
+{ unsigned long h=2166136261UL;
+  if(*s)h=(h^(*s++&127))*16777619UL; /* see mkprivate() */
+  while(*s)h=(h^(unsigned char)*s++)*16777619UL;
+  return(h);
+}
 
-int hash(s) /* returns a value in {0..127} */
+static word *idslot(s) /* first slot holding an id named s, or empty slot */
 char *s;
-{ int h = *s;
-  if(h)while(*++s)h ^= *s; /* guard necessary to deal with s empty */
-  return(h&127);
+{ word i=namehash(s)&(idtabsize-1);
+  while(idtab[i]&&strcmp(get_id(idtab[i]),s))i=(i+1)&(idtabsize-1);
+  return(idtab+i);
 }
 
+static void identer(x) /* enter id x in idtab, ahead of any of same name */
+word x;
+{ word *p,y;
+  if(2*(nids+1)>idtabsize)
+    { word *old=idtab,n=idtabsize,i,e;
+      idtab=(word *)calloc(idtabsize*=2,sizeof(word));
+      if(idtab==NULL)mallocfail("name table");
+      for(e=0;old[e];e++); /* rehash in probe order, from an empty slot,
+			      so that ids of the same name keep their order */
+      for(i=(e+1)&(n-1);i!=e;i=(i+1)&(n-1))
+         if(y=old[i])
+           { word j=namehash(get_id(y))&(idtabsize-1);
+             while(idtab[j])j=(j+1)&(idtabsize-1);
+             idtab[j]=y; }
+      free(old); }
+  nids++;
+  for(p=idslot(get_id(x));*p;p=idtab+((p-idtab+1)&(idtabsize-1)))
+     y= *p, *p=x, x=y;
+  *p=x;
+}
+/* an id shadows earlier ones of the same name (see predef() in steer.c) by
+   moving the rest of its cluster up one slot, so they are found again when
+   its name is disguised by mkprivate() */
+
 int isconstrname(s)
 char *s;
 { if(s[0]=='$')s++;
@@ -1032,35 +1075,33 @@ word x;
 }
 
 word name()
-{ word q,h;
-  q= namebucket[h=hash(dicp)];
-  while(q&&!is(get_id(hd[q])))q= tl[q];
+{ word q=*idslot(dicp);
   if(q==0)
   { q = sto_id(dicp);
-    namebucket[h] = cons(q,namebucket[h]);
+    identer(q);
     keep(dicp); }
-  else q= hd[q]; 
   return(q); }
-/* note - keeping buckets sorted didn't seem to help (if anything slightly
-   slower) probably because ordering only relevant if name not present, and
-   outweighed by increased complexity of loop */
 
 int inprelude=1;
 
 word make_id(n)  /* used in mira_setup(), primdef(), predef(), all in steer.c */
 char *n;
-{ word x,h;
-  h=hash(n);
+{ word x;
   x = sto_id(inprelude?keep(n):n);
-  namebucket[h] = cons(x,namebucket[h]);
+  identer(x);
   return(x); }
 
 word findid(n)  /* like name() but returns NIL rather than create new id */
 char *n;
-{ word q;
-  q= namebucket[hash(n)];
-  while(q&&!strcmp(n,get_id(hd[q]))==0)q= tl[q];
-  return(q?hd[q]:NIL); }
+{ word q=*idslot(n);
+  return(q?q:NIL); }
+
+void idreplace(x,y) /* y replaces id x in idtab, see privatise() */
+word x,y;
+{ word i=namehash(get_id(x))&(idtabsize-1);
+  while(idtab[i]&&idtab[i]!=x)i=(i+1)&(idtabsize-1);
+  if(idtab[i])idtab[i]=y;
+}
 
 word *pnvec=0,nextpn,pn_lim=200;  /* private name vector */
 
@@ -1097,7 +1138,7 @@ word x;       /* used in setting up prelude - see main() in steer.c */
 { while(x!=NIL)
   { char *s = get_id(hd[x]);
     get_id(hd[x])[0] += 128;  /* hack to make private internal name */
-    x = tl[x]; }                /* NB - doesn't change hashbucket */
+    x = tl[x]; }                /* NB - doesn't move it in idtab */
   inprelude=0;
 }
 
@@ -5,7 +5,7 @@ void dic_check(void);
 void dicovflo(void);
 word findid(char*);
 word getfname(word);
-int hash(char*);
+void idreplace(word,word);
 int isconstrname(char*);
 char *keep(char*);
 void layout(void);
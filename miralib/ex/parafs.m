@@ -5,7 +5,7 @@ c p = C (sort p)    ||place subcomponents in a standard order
 molecules n = mkset [ mk_molecule x | x <- radicals n ]
 mk_molecule(C p) = canonical_orientation (C(H:p))
 radicals 0 = [H]
-radicals n = (map rads [1..])!(n-1)  || make rads a memo function
+radicals n = memo rads n
 rads n = mkset [ c[x,y,z] | i <- [0..(n-1)div 3]; j <- [i..(n-1-i)div 2];
                  x <- radicals i; y <- radicals j; z <- radicals(n-1-i-j) ]
 canonical_orientation x = min (closure reorientations [x])
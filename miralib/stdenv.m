@@ -29,6 +29,32 @@ result in the range -pi/2 to pi/2.  See also `sin', `cos'.
 
 > arctan :: num->num ||defined internally
 
+`array' is an abstract type of sequences of fixed length whose elements,
+numbered from 0 as for `!', can each be selected in  constant  time.   An
+array  is made from a list by `listarray', which evaluates the structure
+of the list but not its elements, and turned back into  one  by  `arraylist'.
+`asub a i' is the i'th element of array a and `asize a' the number of
+elements.  `aslice m n a' is the array of elements m..(n-1) of a,  those
+that  exist, and `amap f a' the array obtained by applying f to each
+element of a.
+
+> abstype array *
+> with listarray :: [*]->array *  ||defined internally
+>      arraylist :: array *->[*]
+>      asub :: array *->num->*  ||defined internally
+>      asize :: array *->num  ||defined internally
+>      aslice :: num->num->array *->array *  ||defined internally
+>      amap :: (*->**)->array *->array **  ||defined internally
+>      showarray :: (*->[char])->array *->[char]
+
+> array * == [*]  ||not really - an array is primitive to Miranda
+> arraylist a = [asub a i | i<-[0..asize a-1]]
+> showarray f a = "(listarray [" ++ g (arraylist a) ++ "])"
+>                 where
+>                 g [] = []
+>                 g [b] = f b
+>                 g (b:x) = f b ++ "," ++ g x
+
 `bool' is the type comprising the two truthvalues.
 
         bool ::= False | True ||primitive to Miranda
@@ -290,6 +316,16 @@ Example:  iterate  (2*) 1 yields a list of the powers of 2.
 Note use of ", .." to generate an arbitrary sequence (see manual section
 13/2).
 
+`join' applied to a separator and a list of lists, joins them together
+with the separator between each one and the next.  Example
+        join ", " ["red","green","blue"] = "red, green, blue"
+It is the inverse of `splitby', in that join [c] (splitby c x) = x.
+
+> join :: [*]->[[*]]->[*]    ||defined internally, as below
+
+  join s [] = []
+  join s (a:x) = a ++ concat [s++b | b<-x]
+
 `last' applied to a non empty  list  returns  its  last  element.   This
 function is the dual of `hd'.  Note that for any non-empty list x
         (init x ++ [last x]) = x
@@ -341,16 +377,17 @@ characters are removed from the result.  Example, `lines' applied to
         "hello world\nit's me,\neric\n"
 returns ["hello world","it's  me","eric"].   Note  that  `lines'  treats
 newline  as  a  terminator, not a separator (although it will tolerate a
-missing '\n' on the last line).
+missing '\n' on the last line).  See also `splitby'.
+
+> lines :: [char]->[[char]]    ||defined internally, as below
 
-> lines :: [char]->[[char]]
-> lines [] = []
-> lines (a:x) = []:lines x,   if a='\n'
->             = (a:x1):xrest, otherwise
->               where 
->               (x1:xrest) = lines x, if x~=[]
->                          = []:[],   otherwise
->                            ||this handles missing '\n' on last line
+  lines [] = []
+  lines (a:x) = []:lines x,   if a='\n'
+              = (a:x1):xrest, otherwise
+                where
+                (x1:xrest) = lines x, if x~=[]
+                           = []:[],   otherwise
+                             ||this handles missing '\n' on last line
 
 Note that the inverse of `lines' is the function `lay', in that applying
 `lay'  to the output of `lines' will restore the original string (except
@@ -374,6 +411,11 @@ first) so it is possible to take log, or log10, of very large integers.
 
 > log10 :: num->num      ||defined internally
 
+`lrumemo n f' is like `memo f' but remembers only the results for  the
+n arguments it was most recently applied to (any number if n is 0).
+
+> lrumemo :: num->(*->**)->*->**  ||defined internally
+
 `map' applied to a function and a list returns a copy  of  the  list  in
 which the given function has been applied to every element.
 
@@ -412,6 +454,19 @@ value is or not present in the list.
 > member :: [*]->*->bool
 > member x a = or (map (=a) x)
 
+`memo' applied to a function returns the same function, except that it
+remembers  its  result  for  each  argument, so each is computed at most
+once, for as long as the memo function itself remains in use.  Arguments
+are evaluated completely and compared as by `=', so they may not contain
+functions.  Example - a  memo function that calls itself
+        fib = memo f
+              where
+              f n = n, if n<2
+                  = fib (n-1) + fib (n-2), otherwise
+takes  linear  rather  than  exponential time.  See also `lrumemo'.
+
+> memo :: (*->**)->*->**  ||defined internally
+
 `merge' applied to two sorted lists merges  them  to  produce  a  single
 sorted result.  Used to define `sort', see later.
 
@@ -437,12 +492,12 @@ the built in ordering of '<'.
 `mkset' applied to a list returns a copy of  the  list  from  which  any
 duplicated  elements have been removed.  A list without duplications can
 be used to represent a set, whence the name.   Works  even  on  infinite
-list,  but  (beware)  takes  a  time quadratic in the number of elements
-processed.
+list, and takes a time n log n in the number of elements processed.
+
+> mkset :: [*]->[*]  ||defined internally, as below
 
-> mkset :: [*]->[*]
-> mkset [] = []
-> mkset (a:x) = a:filter (~=a) (mkset x)
+  mkset [] = []
+  mkset (a:x) = a:filter (~=a) (mkset x)
 
 `neg' is a function of one numeric argument, with the same action as the
 unary `-' operator.
@@ -467,6 +522,37 @@ characters cause an error (exception - leading white space is harmless).
 > or :: [bool]->bool
 > or = foldr (\/) False
 
+`par' applied to two values returns the second, but first hands the first
+to another processor, if one is free, to be evaluated completely while the
+second is computed.  Example
+        par a (pseq b (f a b))
+where a is a large computation independent of b.  The value of a is sent
+back to this process when f needs it, which waits for it if it is not
+ready by then.  Note that all of a is evaluated, even parts f does not
+use, so a should be a finite value needed in full and worth the cost of
+a new process - an infinite a holds up f until the other process runs
+out of heap.  If a cannot be sent it is evaluated here in the usual way,
+as it is if a is a function, depends on input or is undefined - so the
+result is the same as without par, unless a has a part that f does not
+use and whose evaluation never ends.  See also `pseq'.
+
+> par :: *->**->** ||defined internally
+
+`parmap n f' is like `map f', but applies f in n processes  of  its  own,
+which run in parallel on a machine with enough processors.  Unlike  `map'
+it is strict: elements of the list are evaluated completely, here, to be
+sent to those processes, up to 64*n of them ahead of the results in use,
+and each result is evaluated completely before it is sent back.  So  all
+elements and results must be finite and defined, even those that `map f'
+would not have needed - otherwise the program may fail, or not end, where
+`map f' would not.  Elements are sent in order, and results returned in
+order as they are needed, so the list itself may be infinite.  f should
+take long enough to be worth the cost of sending each element and result.
+Example
+        parmap 8 analyse (lines (read "records"))
+
+> parmap :: num->(*->**)->[*]->[**] ||defined internally
+
 `pi' is the well known real number (the ratio of the circumference of  a
 circle to its diameter).
 
@@ -485,6 +571,13 @@ the list.  This is the dual of the prefix operator, `:'.
 > product :: [num]->num
 > product = foldl (*) 1
 
+`pseq' is the same as `seq', and is used with `par' to say that the first
+argument is to be evaluated before the second, as in
+        par a (pseq b (a+b))
+which evaluates a and b at the same time, if there is a free processor.
+
+> pseq :: *->**->** ||defined internally
+
 `read' returns the contents of file with a given pathname.  Provides  an
 interface  to  the  UNIX  filing  system.   If  the file is empty `read'
 returns [], but if the file does not exist, or  lacks  read  permission,
@@ -547,6 +640,17 @@ f::state->input->state, its state transition function - then `scan f s0'
 is  a function that takes a list of inputs for the automaton and returns
 the resulting list of states, starting with s0.
 
+`search' applied to two strings returns the list of positions at which
+the first occurs in the second, counting from 0 as for `!'.  Example
+        search "an" "banana" = [1,3]
+Occurrences may overlap.  The positions are found one at a time, so
+        search p x ~= []
+is a test for whether p occurs in x that stops at the first occurrence.
+
+> search :: [char]->[char]->[num]    ||defined internally, as below
+
+  search p x = [i | i<-index x ++ [#x]; take (#p) (drop i x) = p]
+
 `seq' applied to two values, returns the  second  but  checks  that  the
 first  value  is  not  completely  undefined.  Sometimes needed, e.g. to
 ensure correct synchronisation in interactive programs.
@@ -599,21 +703,36 @@ format,  that  is  in  the  form "n.nnnnnne[+/-]nn", where the integer p
 ascending order on the built in '<' relation.  Note that you cannot sort
 a list of functions.  Example
         sort "hippopotamus" = "ahimoopppstu"
-The following definition uses merge-sort, which has n log  n  worst-case
-behaviour.
+It is a merge-sort, which has n log n worst-case behaviour, and  is  stable
+- elements which are equal stay in their original order.
+
+> sort :: [*]->[*]  ||defined internally, as below
 
-> sort :: [*]->[*]
-> sort x = x,                                         if n<=1
->	 = merge (sort(take n2 x)) (sort(drop n2 x)), otherwise
->	   where
->	   n = # x
->	   n2 = n div 2
+  sort x = x,                                         if n<=1
+	 = merge (sort(take n2 x)) (sort(drop n2 x)), otherwise
+	   where
+	   n = # x
+	   n2 = n div 2
 
 `spaces' applied to a number returns a list of that many spaces.
 
 > spaces :: num->[char]
 > spaces n = rep n ' '
 
+`splitby' applied to a character and a string, breaks the string into the
+fields separated by that character, which are removed.  Example
+        splitby ',' "1,,2" = ["1","","2"]
+Unlike `lines', splitby treats the character as a separator, so there is
+always one more field than there are separators.
+
+> splitby :: char->[char]->[[char]]    ||defined internally, as below
+
+  splitby c x = f : splitby c (tl x'),  if x' ~= []
+              = [f],                    otherwise
+                where
+                f = takewhile (~=c) x
+                x' = drop (#f) x
+
 `sqrt' is the square root function on (integer or  fractional)  numbers.
 The result is always fractional.
 
@@ -651,6 +770,39 @@ resulting  from  the  execution of the UNIX command.  See manual section
 
 > system :: [char]->([char],[char],num)  ||defined internally
 
+`table' is an abstract type of finite maps from keys of type * to values
+of  type  **.  A table is made from a list of (key,value) pairs by `listtable',
+a later pair taking precedence over an earlier one with  the  same  key,
+and  turned  back  into one by `tablelist', in no particular order.
+`tinsert k v t' is t with k bound to v, `tdelete k t' is t  without  k,
+and `tlookup d k t' is the value of k in t, or d if there is none.  These
+take a time that does not grow with the size of the table,  and  leave
+t  itself  unchanged.  Keys are compared as by `=', and are evaluated
+completely, values are not evaluated.  `tfold f z t' is
+        f k1 v1 (f k2 v2 (.. z))
+for the entries of t in the order of `tablelist'.
+
+> abstype table * **
+> with emptytable :: table * **
+>      listtable :: [(*,**)]->table * **  ||defined internally
+>      tablelist :: table * **->[(*,**)]
+>      tinsert :: *->**->table * **->table * **  ||defined internally
+>      tlookup :: **->*->table * **->**  ||defined internally
+>      tdelete :: *->table * **->table * **  ||defined internally
+>      tfold :: (*->**->***->***)->***->table * **->***  ||defined internally
+>      showtable :: (*->[char])->(**->[char])->table * **->[char]
+
+> table * ** == [(*,**)]  ||not really - a table is primitive to Miranda
+> emptytable = listtable []
+> tablelist = tfold f []
+>             where
+>             f k v x = (k,v):x
+> showtable f g t = "(listtable [" ++ h (tablelist t) ++ "])"
+>                   where
+>                   h [] = []
+>                   h [(k,v)] = "(" ++ f k ++ "," ++ g v ++ ")"
+>                   h ((k,v):x) = h [(k,v)] ++ "," ++ h x
+
 `take' applied to a number and a list returns the  specified  number  of
 elements  from  the  front  of  the list.  If the list has less than the
 required number of elements, `take' returns  as  many  as  it  can  get.
@@ -12,11 +12,14 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 struct stat buf;  /* used only by code for FILEMODE, FILESTAT in reduce */
 #include "data.h"
 #include "big.h"
 #include "lex.h"
-extern int debug, UTF8, UTF8OUT;
+extern int debug, UTF8, UTF8OUT, packrat;
 #define FST HD
 #define SND TL
 #define BSDCLOCK
@@ -37,17 +40,63 @@ static void div_error(void);
 static void fn_error(char *);
 static void getenv_error(char *);
 static word g_residue(word);
+static word lexch(word);
+static word lexeme(word,word);
 static void lexfail(word);
+static word lexmatch(word,word,word *);
 static word lexstate(word);
-static int memclass(int,word);
+static word memo_find(word,word);
+static word memohash(word,word);
+static void memo_put(word,word,word);
+static void memo_rehash(word);
+static word fm_find(word,word,unsigned long);
+static struct fmemo *fm_new(word,word,unsigned long);
+static void fm_put(word,word,unsigned long,word,word);
+static void fm_rehash(word);
 static word numplus(word,word);
 static void outf(word);
 static word piperrmess(word);
 static void print(word);
+static int bagdel(word,word);
 static word reduce(word);
+static int setadd(word,word,int);
+static word sortlist(word);
+static word listarray(word);
+static word bucketdel(word,word);
+static word bucketput(word,word);
+static unsigned long hashval(word);
+static word tabdel(word,word,unsigned long,word);
+static word tabfold(word,word,word);
+static word tabget(word,word);
+static word tabins(word,word,word);
+static word tabnode(word,word,word,word);
+static word tabput(word,word,unsigned long,word);
+static word clearstack(void);
+static word copyapp(word,word);
+static word field(word,word);
+static word nextfield(word,word,word *);
+static word kmp(word);
+static void pm_close(word,word);
+static word pm_find(word);
+static void pm_kill(word);
+static word pm_new(word,word);
+static word pm_recv(word,word,word *);
+static word pm_send(word,word,word *);
+static word pm_start(word,word,word *);
+static void pm_worker(int,int,word);
+static void spark(word);
+static void spark_kill(word);
+static void spark_stop(void);
+static word spark_val(word,word *);
+static word splay(word,word,int);
+static void sortv(word *,word *,word);
 static void stdin_error(int);
 static void subs_error(void);
 static void int_error(char *);
+static word *kmpat=NULL,*kmfail=NULL,kmsize=0,kmplen=0; /* see kmp() */
+word kmp_p=NIL;
+static word sparkchild=0; /* see spark() */
+static word *sortbufs=NULL; /* see sortlist() */
 
 #define constr_tag(x) hd[x]
 #define idconstr_tag(x) hd[id_val(x)]
@@ -58,6 +107,8 @@ static void int_error(char *);
 #define isodigit(x) ('0'<=(x) && (x)<='7')
 #define sign(x)  (x)
 #define fsign(x)  ((d=(x))<0?-1:d>0)
+#define slotrank(t) ((t)==PAIR?1:(t)==CONS?2:(t)==HAMT?3:0)
+	/* order of the kinds of table slot, entry < bucket < node */
 /* ### */          /* functions marked ### contain possibly recursive calls
 		      to reduce - fix later */
 
@@ -86,7 +137,7 @@ word a,b;
         if(tag[b]==CONSTRUCTOR)
 	  return(sign(constr_tag(a)-constr_tag(b))); /*order of declaration*/
         else return(-1); /* atom less than non-atom */
-      case CONS: case AP:
+      case CONS: case AP: case PAIR:
       if(tag[a]==tag[b])
         { word temp;
           hd[a]=reduce(hd[a]);
@@ -96,7 +147,26 @@ word a,b;
           b=tl[b]=reduce(tl[b]);
           goto L; }
       else if(S<=b&&b<=ERROR)fn_error("attempt to compare functions");
-	   else return(1); /* non-atom greater than atom */
+      else if(slotrank(tag[a])&&slotrank(tag[b])) /* tables */
+	     return(sign(slotrank(tag[a])-slotrank(tag[b])));
+      else return(1); /* non-atom greater than atom */
+      case ARRAY:  /* as for the list of the elements */
+      if(tag[b]==ARRAY)
+        { word i,temp;
+          for(i=0;i<tl[a]&&i<tl[b];i++)
+             { arrayv(a)[i]=reduce(arrayv(a)[i]);
+               arrayv(b)[i]=reduce(arrayv(b)[i]);  /* ### */
+               if((temp=compare(arrayv(a)[i],arrayv(b)[i]))!=0)return(temp); }
+          return(sign(tl[a]-tl[b])); }
+      else return(1);
+      case HAMT:  /* equal tables have the same shape, see tables below */
+      if(tag[b]==HAMT)
+        { word i,temp;
+          if(tl[a]!=tl[b])return((unsigned long)tl[a]<tl[b]?-1:1);
+          for(i=0;i<hamtsize(a);i++)
+             if((temp=compare(hamtv(a)[i],hamtv(b)[i]))!=0)return(temp);
+          return(0); }
+      else return(1); /* greater than an atom, entry or bucket */
       default: fprintf(stderr,"\nghastly error in compare\n");
      }
   return(0);
@@ -119,10 +189,285 @@ word x;   /* x is already reduced */ /* ### */
 		      { hd[x]=reduce(hd[x]);
 	                force(hd[x]);
 	                x=tl[x]=reduce(tl[x]); }
+               return;
+      case ARRAY: { word i;
+                    for(i=0;i<tl[x];i++)
+                       force(arrayv(x)[i]=reduce(arrayv(x)[i]));
+                  }
+                  return;
+      case HAMT: { word i;
+                   for(i=0;i<hamtsize(x);i++)force(hamtv(x)[i]);
+                 }
+                 return;
+      case PAIR: force(tl[x]=reduce(tl[x])); /* table entry, key is forced */
     }
   return;
 }
 
+word sortlist(x) /* merge sort of list x, already reduced - the list is
+		    copied, equal elements keeping their order */ /* ### */
+word x;
+{ word n=0,i,y,*v,*w;
+  for(y=x;y!=NIL;y=tl[y]=reduce(tl[y]))
+     hd[y]=reduce(hd[y]),n++;
+  if(n<2)return(x);
+  v=(word *)malloc((2*n+1)*sizeof(word));
+  if(v==NULL)mallocfail("sort");
+  v[0]=(word)sortbufs,sortbufs=v++; /* see sort_reset() */
+  w=v+n;
+  for(i=0,y=x;i<n;i++,y=tl[y])v[i]=hd[y];
+  sortv(v,w,n);
+  for(y=NIL;n--;)y=cons(v[n],y);
+  sortbufs=(word *)v[-1];
+  free(v-1);
+  return(y);
+} /* the elements stay reachable from x while compare() reduces them */
+
+void sort_reset() /* called by reset() - frees the workspace of the sorts
+		     interrupted, compare() can reduce an element that sorts */
+{ word *p;
+  while(sortbufs)p=sortbufs,sortbufs=(word *)p[0],free(p);
+}
+
+word listarray(x) /* array of the elements of list x, whose spine is forced */
+word x;           /* ### */
+{ word n=0,y,a;
+  for(y=x=reduce(x);y!=NIL;y=tl[y]=reduce(tl[y]))n++;
+  a=mkarray(n);
+  for(y=x;y!=NIL;y=tl[y])arrayv(a)[tl[a]++]=hd[y];
+  return(a);
+}
+
+void sortv(v,w,n) /* sort v[0..n-1] in place, w is workspace of size n */
+word *v,*w,n;
+{ word m=n/2,i,j,k;
+  if(n<2)return;
+  sortv(v,w,m);
+  sortv(v+m,w,n-m);
+  if(compare(v[m-1],v[m])<=0)return; /* already in order, eg presorted */
+  for(i=0;i<m;i++)w[i]=v[i];
+  for(i=0,j=m,k=0;i<m&&j<n;)
+     v[k++]=compare(w[i],v[j])<=0?w[i++]:v[j++];
+  while(i<m)v[k++]=w[i++];
+}
+
+/* sets and bags for MKSET and LISTDIFF are splay trees in the heap, ordered
+   by compare(), so an element is compared only with others in the same
+   collection, never hashed - elements are as lazy as compare() allows.
+   a tree is NIL or cons(a,cons(left,right)), and is held in the hd of a
+   cons cell which is updated in place */
+#define sp_left(t) hd[tl[t]]
+#define sp_right(t) tl[tl[t]]
+static int splayc; /* last comparison made by splay() */
+
+word splay(t,a,max) /* splay tree t about a, or its greatest element if max,
+		       result has at its root a or a neighbour of a */
+word t,a; /* a already reduced */ /* ### */
+int max;
+{ word l=NIL,r=NIL,*lp= &l,*rp= &r,y;
+  int c;
+  if(t==NIL)return(t);
+  for(;;)
+     { c=max?1:compare(a,hd[t]);
+       if(c<0)
+         { if(sp_left(t)==NIL)break;
+           if(compare(a,hd[sp_left(t)])<0) /* rotate right */
+             { y=sp_left(t),sp_left(t)=sp_right(y),sp_right(y)=t,t=y;
+               if(sp_left(t)==NIL)break; }
+           *rp=t,rp= &sp_left(t),t=sp_left(t); }
+       else if(c>0)
+         { if(sp_right(t)==NIL)break;
+           if(max||compare(a,hd[sp_right(t)])>0) /* rotate left */
+             { y=sp_right(t),sp_right(t)=sp_left(y),sp_left(y)=t,t=y;
+               if(sp_right(t)==NIL)break; }
+           *lp=t,lp= &sp_right(t),t=sp_right(t); }
+       else break; }
+  *lp=sp_left(t),*rp=sp_right(t);
+  sp_left(t)=l,sp_right(t)=r;
+  splayc=c;
+  return(t);
+}
+
+int setadd(s,a,dups) /* add a to the tree held in s, unless present and !dups
+		        returns 1 if added */
+word s,a; /* a already reduced */ /* ### */
+int dups;
+{ word t=hd[s]=splay(hd[s],a,0);
+  if(t==NIL)hd[s]=cons(a,cons(NIL,NIL)); else
+  if(splayc==0&&!dups)return(0); else
+  if(splayc<0)hd[s]=cons(a,cons(sp_left(t),t)),sp_left(t)=NIL;
+  else hd[s]=cons(a,cons(t,sp_right(t))),sp_right(t)=NIL;
+  return(1);
+}
+
+int bagdel(s,a) /* remove one copy of a from the tree held in s, if present */
+word s,a; /* a already reduced */ /* ### */
+{ word t=hd[s]=splay(hd[s],a,0);
+  if(t==NIL||splayc)return(0);
+  if(sp_left(t)==NIL)hd[s]=sp_right(t);
+  else hd[s]=splay(sp_left(t),a,1),sp_right(hd[s])=sp_right(t);
+  return(1);
+}
+
+/* tables for LISTTABLE etc are hash array mapped tries.  A node is a HAMT
+   cell whose tl is a bitmap of the slots, out of 32, that are in use and
+   whose hd is a vector of their contents, in slot order.  A slot holds an
+   entry pair(k,v), a node for the next 5 bits of hash, or, where the hash
+   is used up, a bucket - a list of entries in compare() order.  So the
+   shape of a table depends only on its keys, and compare() can walk two
+   tables side by side.  Nodes are never changed once filled in, and each
+   but the root has at least two entries below it.  Keys are forced by
+   hashing, values are left alone. */
+#define HDEPTH (__WORDSIZE/5) /* levels of node before the hash runs out */
+#define hbit(h,d) (1L<<((h)>>(__WORDSIZE-5-5*(d))&31))
+#define hindex(t,b) __builtin_popcountl(tl[t]&((b)-1)) /* slot to vector */
+#define hmix(h,k) (((h)^(unsigned long)(k))*0x9E3779B97F4A7C15UL)
+
+unsigned long hashval(x) /* hash of x, equal under compare() means equal hash
+			    - x already reduced, its parts are reduced here */
+word x;                  /* ### */
+{ unsigned long h=0;
+  union { double d; unsigned long u; } r;
+  for(;;)
+  switch(tag[x])
+  { case DOUBLE: r.u=0;
+                 r.d=get_dbl(x);
+                 if(r.d==0)r.d=0; /* -0.0 */
+                 return(hmix(h,r.u));
+    case INT: r.u=0;
+              r.d=bigtodbl(x); /* as compare() for INT with DOUBLE */
+              return(hmix(h,r.u));
+    case UNICODE: return(hmix(h,get_char(x)));
+    case ATOM: if(S<=x&&x<=ERROR)fn_error("attempt to compare functions");
+               return(hmix(h,x));
+    case CONSTRUCTOR: return(hmix(h,constr_tag(x)));
+    case CONS: case AP: case PAIR:
+               hd[x]=reduce(hd[x]);
+               h=hmix(hmix(h,tag[x]),hashval(hd[x]));
+               x=tl[x]=reduce(tl[x]);
+               continue;
+    case ARRAY: { word i;
+                  for(i=0;i<tl[x];i++)
+                     arrayv(x)[i]=reduce(arrayv(x)[i]),
+                     h=hmix(h,hashval(arrayv(x)[i]));
+                  return(hmix(h,tl[x])); }
+    case HAMT: { word i;
+                 for(i=0;i<hamtsize(x);i++)h=hmix(h,hashval(hamtv(x)[i]));
+                 return(hmix(h,tl[x])); }
+    default: return(h);
+  }
+}
+
+word tabnode(t,b,i,c) /* copy of node t with bitmap b, which adds or removes
+                         slot i, or if b is tl[t] replaces its contents by c */
+word t,b,i,c;
+{ word r=mkhamt(b),j,n=hamtsize(t);
+  for(j=0;j<i;j++)hamtv(r)[j]=hamtv(t)[j];
+  if(b==tl[t])
+    { hamtv(r)[i]=c;
+      for(j=i+1;j<n;j++)hamtv(r)[j]=hamtv(t)[j]; } else
+  if(b&~tl[t])
+    { hamtv(r)[i]=c;
+      for(j=i;j<n;j++)hamtv(r)[j+1]=hamtv(t)[j]; }
+  else for(j=i+1;j<n;j++)hamtv(r)[j-1]=hamtv(t)[j];
+  return(r);
+}
+
+word tabput(t,e,h,d) /* node t, at depth d, with entry e put in, replacing
+                        any with the same key - h is the hash of the key */
+word t,e,d;          /* ### */
+unsigned long h;
+{ word b=hbit(h,d),i=hindex(t,b),c;
+  if(!(tl[t]&b))return(tabnode(t,tl[t]|b,i,e));
+  c=hamtv(t)[i];
+  if(tag[c]==HAMT)c=tabput(c,e,h,d+1); else
+  if(tag[c]==PAIR)
+    { int o=compare(hd[e],hd[c]);
+      if(o==0)c=e; else
+      if(d+1<HDEPTH)c=tabput(tabput(mkhamt(0),c,hashval(hd[c]),d+1),e,h,d+1);
+      else c=o<0?cons(e,cons(c,NIL)):cons(c,cons(e,NIL)); }
+  else c=bucketput(c,e);
+  return(tabnode(t,tl[t],i,c));
+}
+
+word bucketput(x,e)
+word x,e;  /* ### */
+{ int o;
+  if(x==NIL)return(cons(e,NIL));
+  if((o=compare(hd[e],hd[hd[x]]))<0)return(cons(e,x));
+  if(o==0)return(cons(e,tl[x]));
+  return(cons(hd[x],bucketput(tl[x],e)));
+}
+
+word tabins(t,k,v) /* table t with k bound to v */
+word t,k,v;        /* ### */
+{ k=reduce(k);
+  return(tabput(t,make(PAIR,k,v),hashval(k),0));
+}
+
+word tabdel(t,k,h,d) /* node t, at depth d, without key k - t itself if k
+                        is not there */
+word t,k,d;          /* ### */
+unsigned long h;
+{ word b=hbit(h,d),i=hindex(t,b),c,r;
+  if(!(tl[t]&b))return(t);
+  c=hamtv(t)[i];
+  if(tag[c]==HAMT)
+    { r=tabdel(c,k,h,d+1);
+      if(r!=c&&hamtsize(r)==1&&tag[hamtv(r)[0]]==PAIR)r=hamtv(r)[0]; }
+  else if(tag[c]==PAIR)r=compare(k,hd[c])?c:NIL;
+  else if((r=bucketdel(c,k))!=c&&tl[r]==NIL)r=hd[r];
+  if(r==c)return(t);
+  return(r==NIL?tabnode(t,tl[t]&~b,i,NIL):tabnode(t,tl[t],i,r));
+}
+
+word bucketdel(x,k)
+word x,k;  /* ### */
+{ word y;
+  if(x==NIL)return(x);
+  if(compare(k,hd[hd[x]])==0)return(tl[x]);
+  y=bucketdel(tl[x],k);
+  return(y==tl[x]?x:cons(hd[x],y));
+}
+
+word tabget(t,k) /* the entry for k in table t, or NIL */
+word t,k;        /* k already reduced */ /* ### */
+{ unsigned long h=hashval(k);
+  word d=0,b,c;
+  for(;;)
+     { b=hbit(h,d);
+       if(!(tl[t]&b))return(NIL);
+       c=hamtv(t)[hindex(t,b)];
+       if(tag[c]!=HAMT)break;
+       t=c,d++; }
+  if(tag[c]==PAIR)return(compare(k,hd[c])?NIL:c);
+  for(;c!=NIL;c=tl[c])
+     if(compare(k,hd[hd[c]])==0)return(hd[c]);
+  return(NIL);
+}
+
+word tabfold(f,z,x) /* f k1 v1 (f k2 v2 (.. z)) over the entries in x, which
+                       is a node or the contents of a slot */
+word f,z,x;
+{ word i;
+  switch(tag[x])
+  { case PAIR: return(ap3(f,hd[x],tl[x],z));
+    case CONS: return(tabfold(f,tabfold(f,z,tl[x]),hd[x])); /* bucket */
+    case HAMT: for(i=hamtsize(x);i--;)z=tabfold(f,z,hamtv(x)[i]);
+  }
+  return(z);
+}
+
+word listtable(x) /* table of the pairs in list x, a later pair overriding an
+                     earlier one with the same key */
+word x;           /* ### */
+{ word t=mkhamt(0);
+  for(x=reduce(x);x!=NIL;x=tl[x]=reduce(tl[x]))
+     hd[x]=reduce(hd[x]),
+     t=tabins(t,hd[hd[x]],tl[hd[x]]);
+  return(t);
+}
+
 word head(x)   /* finds the function part of x */
 word x;
 { while(tag[x]==AP)x= hd[x];
@@ -154,6 +499,98 @@ char *cmd; /* context, for error message */
 		   CANNOT WE SUPPORT A PACKED REPRESENTATION OF STRINGS? */
 } /* call keep(linebuf) if you want to save the string */
 
+/* the string primitives LINES, SPLIT, JOIN walk the list in a C loop,
+   rather than by a reduction per element - without evaluating any more of
+   it than the equivalent definitions in stdenv.m would.  A line, field or
+   joined part is returned a chunk at a time, each being as much of it as
+   is already evaluated, up to LINECHUNK elements, see FIELD, copyapp() */
+#define LINECHUNK 256
+#define evalchar(x) ((x)<256||(x)>=ATOMLIMIT&&tag[x]==UNICODE)
+
+/* ### */
+word field(c,x) /* the chars of x before the first c, as far as the first
+                   not yet evaluated, or LINECHUNK of them, followed by
+                   FIELD c for the rest - NIL if x starts with c */
+word c,x;
+{ word f,last,y,n;
+  if((x=reduce(x))==NIL||get_char(hd[x]=reduce(hd[x]))==get_char(c))
+    return(NIL);
+  f=last=cons(hd[x],NIL);
+  for(n=1;n<LINECHUNK&&tag[y=tl[x]]==CONS&&evalchar(hd[y])
+          &&get_char(hd[y])!=get_char(c);n++)
+     x=y,last=tl[last]=cons(hd[x],NIL);
+  y=tl[x];
+  if(y!=NIL&&!(tag[y]==CONS&&evalchar(hd[y])&&get_char(hd[y])==get_char(c)))
+    tl[last]=ap2(FIELD,c,y);
+  return(f);
+}
+
+/* ### */
+word nextfield(c,f,xp) /* the first cell of *xp holding c, or NIL if none -
+                          *xp is moved on as we go, so what is behind us can
+                          be collected.  Whatever of the field f (made by
+                          FIELD c from the same x) is still to be built is
+                          now evaluated, so is copied at once - else f would
+                          hold on to the rest of x till it was used */
+word c,f,*xp;
+{ word x= *xp,y,last,n=0;
+  c=get_char(c);
+  while((x=reduce(x))!=NIL&&get_char(hd[x]=reduce(hd[x]))!=c)
+       if(x=tl[x]=reduce(tl[x]),++n%4096==0)*xp=x;
+  while(tag[f]==CONS)f=tl[f];
+  if(tag[f]!=AP||tag[hd[f]]!=AP||hd[hd[f]]!=FIELD)return(x);
+  if((y=reduce(tl[f]))==x)
+    { hd[f]=I,tl[f]=NIL; return(x); }
+  last=f;
+  for(;;)
+     { tag[last]=CONS,hd[last]=hd[y];
+       if((y=tl[y])==x)break;
+       last=tl[last]=cons(NIL,NIL); }
+  tl[last]=NIL;
+  return(x);
+}
+
+/* ### */
+word copyapp(x,y) /* x++y, with the evaluated part of x copied at once */
+word x,y;
+{ word r=y,last=NIL,c,n=0;
+  if((x=reduce(x))==NIL)return(y);
+  for(;;)
+     { c=cons(hd[x],y);
+       if(last==NIL)r=c; else tl[last]=c;
+       last=c;
+       if((x=tl[x])==NIL)break;
+       if(tag[x]!=CONS||++n==LINECHUNK)
+         { tl[last]=ap2(APPEND,x,y); break; } }
+  return(r);
+}
+
+/* ### */
+word kmp(p) /* tabulates the pattern p for SEARCH, returning its length m -
+               kmpat[0..m-1] are its chars and kmfail[j] is the length of the
+               longest proper prefix of p[0..j-1] that is also its suffix.
+               There is only one table, kmp_p says whose it is - it is
+               kept by the gc, so that a search resumed finds it again */
+word p;
+{ word m=0,i,k,x,x0;
+  kmp_p=NIL; /* in case we are interrupted */
+  x0=reduce(p);
+  for(x=x0;x!=NIL;x=tl[x]=reduce(tl[x]))
+     hd[x]=reduce(hd[x]),m++;
+  if(m>=kmsize)
+    { kmsize=2*m+16;
+      kmpat=(word *)realloc(kmpat,kmsize*sizeof(word));
+      kmfail=(word *)realloc(kmfail,kmsize*sizeof(word));
+      if(kmpat==NULL||kmfail==NULL)mallocfail("search pattern"); }
+  for(i=0,x=x0;i<m;i++,x=tl[x])kmpat[i]=get_char(hd[x]);
+  kmfail[0]= -1;
+  for(k= -1,i=0;i<m;i++)
+     { while(k>=0&&kmpat[k]!=kmpat[i])k=kmfail[k];
+       kmfail[i+1]= ++k; }
+  kmp_p=p,kmplen=m;
+  return(m);
+}
+
 FILE *s_out=NULL;  /* destination of current output message */
                    /* initialised in main() */
 #define Stdout 0
@@ -168,6 +605,18 @@ FILE *s_out=NULL;  /* destination of current output message */
 #define Appendfileb 9
   /* order of declaration of constructors of these names in sys_message */
 
+#define CLEARWORDS 4096
+
+word clearstack() /* zeroes the C stack below us, so that words the compiler
+                     left there are not taken by the gc for pointers into
+                     the value being printed - which would keep a list read
+                     from a file from being collected as it goes */
+{ volatile word junk[CLEARWORDS];
+  word i;
+  for(i=0;i<CLEARWORDS;i++)junk[i]=0;
+  return(junk[0]);
+}
+
 /* ### */
 void output(e)  /* "output" is called by YACC (see rules.y) to print the 
 	      value of an expression - output then calls "reduce" - so the
@@ -177,6 +626,7 @@ word e;
 { 
   extern word *cstack;
   cstack = &e; /* don't follow C stack below this in gc */
+  (void)clearstack();
 L:e= reduce(e);
   while(tag[e]==CONS)
   { word d;
@@ -655,6 +1105,52 @@ word e;
 	 setcell(CONS,hd[lastarg],hold);
     goto DONE;
 
+    case MKSET:        /* MKSET s [] => []
+			  MKSET s (a:x) => a : MKSET s x, a not in s (added)
+					=> MKSET s x, otherwise
+			  s holds the elements so far, see setadd() - it
+			  starts as NIL, shared, so is made here on first use */
+    getarg(arg1);
+    upleft;
+    if(arg1==NIL)hd[e]=ap(MKSET,arg1=cons(NIL,NIL));
+    lastarg=reduce(lastarg);   /* ### */
+    while(lastarg!=NIL&&!setadd(arg1,hd[lastarg]=reduce(hd[lastarg]),0))
+	 lastarg=reduce(tl[lastarg]);   /* ### */
+    if(lastarg==NIL)
+      hd[e]=I, e=tl[e]=NIL;
+    else hold=ap(hd[e],tl[lastarg]),
+	 setcell(CONS,hd[lastarg],hold);
+    goto DONE;
+
+    case LISTDIFF:     /* LISTDIFF x y => LISTDIFF1 b x
+			  where b holds the elements of y, see setadd() */
+    getarg(arg1);
+    upleft;
+    hold=cons(NIL,NIL);
+    for(lastarg=reduce(lastarg);lastarg!=NIL;lastarg=reduce(tl[lastarg]))
+       setadd(hold,hd[lastarg]=reduce(hd[lastarg]),1);   /* ### */
+    hd[e]=ap(LISTDIFF1,hold);
+    tl[e]=arg1;
+    goto NEXTREDEX;
+
+    case LISTDIFF1:    /* LISTDIFF1 b x => x, b empty
+			  LISTDIFF1 b [] => []
+			  LISTDIFF1 b (a:x) => LISTDIFF1 b x, a in b (removed)
+					    => a : LISTDIFF1 b x, otherwise */
+    getarg(arg1);
+    upleft;
+    if(hd[arg1]==NIL)
+      { hd[e]=I; e=lastarg; goto NEXTREDEX; }
+    for(lastarg=reduce(lastarg);lastarg!=NIL;lastarg=reduce(tl[lastarg]))
+       { if(!bagdel(arg1,hd[lastarg]=reduce(hd[lastarg])))break;   /* ### */
+         if(hd[arg1]==NIL)
+           { hd[e]=I; e=tl[e]=tl[lastarg]; goto NEXTREDEX; } }
+    if(lastarg==NIL)
+      hd[e]=I, e=tl[e]=NIL;
+    else hold=ap(hd[e],tl[lastarg]),
+	 setcell(CONS,hd[lastarg],hold);
+    goto DONE;
+
     case LIST_LAST:   /* LIST_LAST x  =>  x!(#x-1)  */
     upleft;
     if((lastarg=reduce(lastarg))==NIL)fn_error("last []");  /* ### */
@@ -706,7 +1202,260 @@ word e;
       e=tl[e]=hd[lastarg];  /* could be eager in tl[e] */
       goto NEXTREDEX; }
 
-    case FOLDL1:      /* FOLDL1 op (a:x) => FOLDL op a x */
+    case LISTARRAY:   /* LISTARRAY x => array of the elements of x */
+    upleft;
+    hold=listarray(lastarg);  /* ### */
+    simpl(hold);
+    goto DONE;
+
+    case ASUB:        /* ASUB a i => a!i, for array a, in one step */
+    upleft;
+    upleft;
+    arg1=tl[hd[e]]=reduce(tl[hd[e]]);  /* ### */
+    lastarg=reduce(lastarg);  /* ### */
+    { long long indx;
+      if(tag[lastarg]==ATOM)indx=lastarg;/* small indexes, see abstrlist */
+      else if(tag[lastarg]==INT)indx=get_int(lastarg);
+      else int_error("asub");
+      if(indx<0||indx>=tl[arg1])subs_error();
+      hd[e]= I;
+      e=tl[e]=arrayv(arg1)[indx];
+      goto NEXTREDEX; }
+
+    case ASIZE:       /* ASIZE a => number of elements of array a */
+    upleft;
+    lastarg=reduce(lastarg);  /* ### */
+    simpl(sto_int(tl[lastarg]));
+    goto DONE;
+
+    case ASLICE:      /* ASLICE m n a => array of a!m..a!(n-1), those that
+                         exist, as take (n-m) (drop m x) for a list */
+    upleft;
+    arg1=lastarg=reduce(lastarg);  /* ### */
+    upleft;
+    arg2=lastarg=reduce(lastarg);  /* ### */
+    upleft;
+    lastarg=reduce(lastarg);  /* ### */
+    if(tag[arg1]!=INT)int_error("aslice");
+    if(tag[arg2]!=INT)int_error("aslice");
+    { long long m=get_int(arg1),n=get_int(arg2),i;
+      if(n>tl[lastarg])n=tl[lastarg];
+      if(m<0)m=0;
+      if(n<m)n=m;
+      hold=mkarray(n-m);
+      for(i=m;i<n;i++)arrayv(hold)[tl[hold]++]=arrayv(lastarg)[i]; }
+    simpl(hold);
+    goto DONE;
+
+    case AMAP:        /* AMAP f a => array of f (a!i) for each i */
+    getarg(arg1);
+    upleft;
+    lastarg=reduce(lastarg);  /* ### */
+    hold=mkarray(tl[lastarg]);
+    while(tl[hold]<tl[lastarg])
+         { arg2=ap(arg1,arrayv(lastarg)[tl[hold]]);
+           arrayv(hold)[tl[hold]++]=arg2; }
+    simpl(hold);
+    goto DONE;
+
+    case LISTTABLE:   /* LISTTABLE x => table of the pairs in list x */
+    upleft;
+    hold=listtable(lastarg);  /* ### */
+    simpl(hold);
+    goto DONE;
+
+    case TINSERT:     /* TINSERT k v t => t with k bound to v */
+    getarg(arg1);
+    getarg(arg2);
+    upleft;
+    lastarg=reduce(lastarg);  /* ### */
+    hold=tabins(lastarg,arg1,arg2);  /* ### */
+    simpl(hold);
+    goto DONE;
+
+    case TLOOKUP:     /* TLOOKUP d k t => value of k in t, or d if none */
+    getarg(arg1);
+    upleft;
+    arg2=lastarg=reduce(lastarg);  /* ### */
+    upleft;
+    lastarg=reduce(lastarg);  /* ### */
+    hold=tabget(lastarg,arg2);  /* ### */
+    hd[e]=I;
+    e=tl[e]=hold==NIL?arg1:tl[hold];
+    goto NEXTREDEX;
+
+    case TDELETE:     /* TDELETE k t => t without k */
+    upleft;
+    arg1=lastarg=reduce(lastarg);  /* ### */
+    upleft;
+    lastarg=reduce(lastarg);  /* ### */
+    hold=tabdel(lastarg,arg1,hashval(arg1),0);  /* ### */
+    simpl(hold);
+    goto DONE;
+
+    case TFOLD:       /* TFOLD f z t => f k1 v1 (f k2 v2 (.. z)) for the
+                         entries of t, in no particular order */
+    getarg(arg1);
+    getarg(arg2);
+    upleft;
+    lastarg=reduce(lastarg);  /* ### */
+    hd[e]=I;
+    e=tl[e]=tabfold(arg1,arg2,lastarg);
+    goto NEXTREDEX;
+
+    case MEMO:        /* MEMO n f x => f x, shared with any earlier MEMO n f x
+                         through the same cell MEMO n f, see fm_find */
+    getarg(arg1);
+    getarg(arg2);
+    arg3=e;  /* the memo function */
+    upleft;
+    arg1=reduce(arg1);  /* ### */
+    if(tag[arg1]!=INT)int_error("lrumemo");
+    lastarg=reduce(lastarg);  /* ### */
+    { unsigned long h=hashval(lastarg);  /* ### */
+      word n;
+      if(!(hold=fm_find(arg3,lastarg,h)))
+        { n=get_int(arg1);
+          hold=ap(arg2,lastarg);
+          fm_put(arg3,lastarg,h,hold,n<0?0:n); }
+      hd[e]=I;
+      e=tl[e]=hold; }
+    goto NEXTREDEX;
+
+    case LINES:       /* LINES [] => []
+                         LINES x => f : NEXTF '\n' LINES f x
+                                    where f = FIELD '\n' x */
+    upleft;
+    if((lastarg=reduce(lastarg))==NIL)  /* ### */
+      { simpl(NIL); goto DONE; }
+    arg1=ap2(FIELD,'\n',lastarg);
+    setcell(CONS,arg1,ap(ap3(NEXTF,'\n',LINES,arg1),lastarg));
+    goto DONE;
+
+    case SPLIT:       /* SPLIT c x => f : NEXTF c (SPLIT c) f x
+                                      where f = FIELD c x */
+    getarg(arg1);
+    upleft;
+    arg1=tl[hd[e]]=reduce(tl[hd[e]]);  /* ### */
+    arg2=ap2(FIELD,arg1,lastarg);
+    setcell(CONS,arg2,ap(ap3(NEXTF,arg1,ap(SPLIT,arg1),arg2),lastarg));
+    goto DONE;
+
+    case FIELD:       /* FIELD c x => the elements of x before the first c,
+                         a chunk at a time, see field() - c is evaluated */
+    getarg(arg1);
+    upleft;
+    if((hold=field(arg1,lastarg))==NIL)  /* ### */
+      { simpl(NIL); goto DONE; }
+    setcell(CONS,hd[hold],tl[hold]);
+    goto DONE;
+
+    case NEXTF:       /* NEXTF c g f (a++[c]++x) => g x
+                         NEXTF c g f a => [], if a has no c
+                         f is the field a, see nextfield() */
+    getarg(arg1);
+    getarg(arg2);
+    getarg(arg3);
+    upleft;
+    if((hold=nextfield(arg1,arg3,&lastarg))==NIL)  /* ### */
+      { simpl(NIL); goto DONE; }
+    simpl(ap(arg2,tl[hold]));
+    goto NEXTREDEX;
+
+    case JOIN:        /* JOIN s [] => []
+                         JOIN s (a:x) => a ++ JOIN1 s x */
+    case JOIN1:       /* JOIN1 s [] => []
+                         JOIN1 s (a:x) => s ++ a ++ JOIN1 s x
+                         a and s are copied a chunk at a time, see copyapp() */
+    getarg(arg1);
+    upleft;
+    arg3=hd[hd[e]];
+    if((lastarg=reduce(lastarg))==NIL)  /* ### */
+      { simpl(NIL); goto DONE; }
+    arg2=ap2(JOIN1,arg1,tl[lastarg]);
+    arg2=copyapp(hd[lastarg],arg2);  /* ### */
+    if(arg3==JOIN1)arg2=copyapp(arg1,arg2);  /* ### */
+    simpl(arg2);
+    goto NEXTREDEX;
+
+    case SEARCH:      /* SEARCH n j p s => the positions of p in s, numbered
+                         from n, where the j chars before s match p already.
+                         Knuth-Morris-Pratt, see kmp() */
+    getarg(arg1);
+    getarg(arg2);
+    getarg(arg3);
+    upleft;
+    { long long n=get_int(arg1),j=get_int(arg2);
+      word m=kmp_p==arg3?kmplen:kmp(arg3),x=lastarg,c;  /* ### */
+      for(;;)
+         { if(j==m)
+             { setcell(CONS,sto_int(n-m),
+                       ap(ap3(SEARCH,sto_int(n),sto_int(kmfail[m]),arg3),x));
+               goto DONE; }
+           if((x=reduce(x))==NIL)  /* ### */
+             { simpl(NIL); goto DONE; }
+           c=get_char(hd[x]=reduce(hd[x]));  /* ### */
+           if(kmp_p!=arg3)m=kmp(arg3); /* a search inside ours */
+           while(j>=0&&kmpat[j]!=c)j=kmfail[j];
+           j++,n++;
+           x=tl[x];
+           if(n%4096==0) /* so that what is behind us can be collected */
+             hd[e]=ap3(SEARCH,sto_int(n),sto_int(j),arg3),lastarg=x; } }
+
+    case PAR:         /* PAR a b => b, a being evaluated meanwhile by another
+                         process if one is free, see spark() */
+    getarg(arg1);
+    upleft;
+    spark(arg1);
+    hd[e]=I; e=lastarg;
+    goto NEXTREDEX;
+
+    case SPARK:       /* SPARK k x => x, as evaluated by the child process
+                         of k if it succeeded, see spark() */
+    getarg(arg1);
+    upleft;
+    { word v;
+      if(spark_val(arg1,&v))lastarg=v; }
+    hd[e]=I; e=lastarg;
+    goto NEXTREDEX;
+
+    case PARMAP:      /* PARMAP n f x => MAP f x, evaluated by n workers,
+                         see pm_new() */
+    getarg(arg1);
+    getarg(arg2);
+    upleft;
+    arg1=reduce(arg1);  /* ### */
+    if(tag[arg1]!=INT)int_error("parmap");
+    { word x=lastarg;
+      hold=pm_start(get_int(arg1),arg2,&x);  /* ### */
+      hd[e]=hold?hold:ap(MAP,arg2);
+      lastarg=x; }
+    goto NEXTREDEX;
+
+    case PARMAP1:     /* PARMAP1 f k ((w,c):q) x => ys ++ PARMAP1 f k q' x'
+                         where ys is MAP f c, as sent back by worker w, who
+                         is sent the next chunk of x for q'
+                         PARMAP1 f k [] x => MAP f x */
+    getarg(arg1);
+    getarg(arg2);
+    getarg(arg3);
+    upleft;
+    { word i=pm_find(arg2),w,c,q,x=lastarg,ys,got;
+      if(arg3==NIL)
+        { if(i>=0)pm_kill(i);
+          hd[e]=ap(MAP,arg1); goto NEXTREDEX; }
+      w=get_int(hd[hd[arg3]]),c=tl[hd[arg3]],q=tl[arg3];
+      got=i>=0&&w>=0&&pm_recv(i,w,&ys);
+      if(i>=0&&(hold=pm_send(i,w<0?-1-w:w,&x))!=NIL)  /* ### */
+        q=append1(q,cons(hold,NIL));
+      hold=ap(ap3(PARMAP1,arg1,arg2,q),x);
+      if(!got)
+        { simpl(ap2(APPEND,ap2(MAP,arg1,c),hold)); goto NEXTREDEX; }
+      (void)append1(ys,hold); /* ys is not shared */
+      setcell(CONS,hd[ys],tl[ys]); }
+    goto DONE;
+
+    case FOLDL1:     /* FOLDL1 op (a:x) => FOLDL op a x */
     getarg(arg1);
     upleft;
     if((lastarg=reduce(lastarg))!=NIL)   /* ### */
@@ -744,6 +1493,7 @@ word e;
     case READBIN:    /*    READBIN streamptr => nextchar : READBIN streamptr
                            if end of file,    READBIN file => NIL
 			   READBIN does no UTF-8 conversion        */
+    if(sparkchild)_exit(1);  /* see spark() */
     UPLEFT;          /* gc insecurity - arg is not a heap object */
     if(lastarg==0) /* special case created by $:- */
       { if(stdinuse=='-')stdin_error(':');
@@ -764,6 +1514,7 @@ word e;
     case READ:        /*    READ streamptr => nextchar : READ streamptr
                             if end of file,    READ file => NIL
     			    does UTF-8 conversion where appropriate     */
+    if(sparkchild)_exit(1);  /* see spark() */
     UPLEFT;           /* gc insecurity - arg is not a heap object */
     if(lastarg==0) /* special case created by $- */
       { if(stdinuse==':')stdin_error('-');
@@ -785,6 +1536,7 @@ word e;
 				            => val : READVALS t f, otherwise
 			 where val is obtained by parsing lines of
 			 f, and taking next legal expr of type t */
+    if(sparkchild)_exit(1);  /* see spark() */
     GETARG(arg1);
     upleft;
     hold=parseline(hd[arg1],(FILE *)lastarg,tl[arg1]);
@@ -861,6 +1613,7 @@ word e;
     case I:    /* we treat I as strict to avoid I-chains (MOD1) */
     case SEQ:
     case FORCE:
+    case SORT:
     case HD:
     case TL:
     case BODY:
@@ -1184,6 +1937,22 @@ word e;
     setcell(CONS,hd[lastarg],ap(G_COUNT,tl[lastarg]));
     goto DONE;
 
+    case G_MEMO:        /* G_MEMO f toks => f toks
+                           wrapped round each nonterminal by %bnf - with
+                           -packrat the result is remembered, see memo_find */
+    GETARG(arg1);
+    upleft;
+    if(!packrat)
+      { hd[e]=arg1; DOWNLEFT; goto NEXTREDEX; }
+    arg2=lastarg;
+    while(tag[arg2]==AP&&hd[arg2]==I)arg2=tl[arg2];
+    if(!(hold=memo_find(arg1,arg2)))
+      { hold=ap(arg1,lastarg);
+        hold=reduce(hold);          /* ### */
+        memo_put(arg1,arg2,hold); }
+    simpl(hold);
+    goto DONE;
+
 /*  Explanation of %lex combinators.  A lex analyser is of type
 
 	lexer == [char] -> [alpha]
@@ -1195,13 +1964,12 @@ word e;
     A lexer1 is guaranteed to return a triple (if it returns at all...)
     and is built using LEX_TRY.
 
-	LEX_TRY [(scstuff,(matcher [],rule))*] :: lexer1
+	LEX_TRY [(scstuff,(re,rule))*] :: lexer1
         rule :: [char] -> alpha
-        matcher :: partial_match -> input -> {(alpha,input') | []}
 
-    partial_match and input are both [char] and [] represents failure.
-    The other lex combinators - LEX_SEQ, LEX_OR, LEX_CLASS etc., all
-    create and combine objects of type matcher.
+    The regular expressions re are built by rules.y from LEX_SEQ, LEX_OR,
+    LEX_CLASS etc. and are not reduced but interpreted by lexmatch(),
+    which walks the input list in C - see below.
 
     LEX_RPT1 is a deviant version that labels the input characters
     with their lexical state (row,col) using LEX_COUNT - goes with
@@ -1240,16 +2008,17 @@ word e;
     case LEX_TRY:
     upleft;
     tl[e]=reduce(tl[e]);  /* ### */
-    force(tl[e]);
+    /* list is explicit, built by codegen - must not force() the regexps */
     hd[e]=LEX_TRY_;
     DOWNLEFT;
     /* falls thru to next case */
 
     case LEX_TRY_:
- /* LEX_TRY ((scstuff,(f,rule)):alt) s x => LEX_TRY alt s x, if f x = []
-				         => (rule (rev a),s,y), otherwise
-					    where
-					    (a,y) = f x
+ /* LEX_TRY ((scstuff,(re,rule)):alt) s x => LEX_TRY alt s x, if re fails on x
+				          => (rule a,s,y), otherwise
+					     where
+					     a is the prefix of x matched by re
+					     y is the rest of x
     LEX_TRY [] s x => BOTTOM
  */
     GETARG(arg1);
@@ -1258,28 +2027,28 @@ word e;
 L2: if(arg1==NIL)lexfail(lastarg);
     if(hd[hd[hd[arg1]]]&&!member(hd[hd[hd[arg1]]],arg2))
       { arg1=tl[arg1]; goto L2; } /* hd[scstuff] is 0 or list of startconds */
-    hold=ap(hd[tl[hd[arg1]]],lastarg);
-    if((hold=reduce(hold))==NIL)        /* ### */
+    arg3=0;
+    if(!(hold=lexmatch(hd[tl[hd[arg1]]],lastarg,&arg3)))        /* ### */
       { arg1=tl[arg1]; goto L2; }
-    setcell(CONS,ap(tl[tl[hd[arg1]]],ap(DESTREV,hd[hold])),
-		 cons(tl[hd[hd[arg1]]]?tl[hd[hd[arg1]]]-1:arg2,tl[hold]));
+    setcell(CONS,ap(tl[tl[hd[arg1]]],lexeme(lastarg,arg3)),
+		 cons(tl[hd[hd[arg1]]]?tl[hd[hd[arg1]]]-1:arg2,hold));
 	        /* tl[scstuff] is 1 + next start condition (0 = no change) */
     goto DONE;
 
     case LEX_TRY1:
     upleft;
     tl[e]=reduce(tl[e]);  /* ### */
-    force(tl[e]);
+    /* list is explicit, built by codegen - must not force() the regexps */
     hd[e]=LEX_TRY1_;
     DOWNLEFT;
     /* falls thru to next case */
 
     case LEX_TRY1_:
- /* LEX_TRY1 ((scstuff,(f,rule)):alt) s x => LEX_TRY1 alt s x, if f x = []
-				          => (rule n (rev a),s,y), otherwise
-				             where
-				             (a,y) = f x
-				             n = lexstate(x)
+ /* LEX_TRY1 ((scstuff,(re,rule)):alt) s x => LEX_TRY1 alt s x, if re fails on x
+				           => (rule n a,s,y), otherwise
+				              where
+				              a,y as for LEX_TRY
+				              n = lexstate(x)
     ||same as LEX_TRY but feeds lexstate to rule
  */
     GETARG(arg1);
@@ -1288,15 +2057,15 @@ L2: if(arg1==NIL)lexfail(lastarg);
 L3: if(arg1==NIL)lexfail(lastarg);
     if(hd[hd[hd[arg1]]]&&!member(hd[hd[hd[arg1]]],arg2))
       { arg1=tl[arg1]; goto L3; } /* hd[scstuff] is 0 or list of startconds */
-    hold=ap(hd[tl[hd[arg1]]],lastarg);
-    if((hold=reduce(hold))==NIL)        /* ### */
+    arg3=0;
+    if(!(hold=lexmatch(hd[tl[hd[arg1]]],lastarg,&arg3)))        /* ### */
       { arg1=tl[arg1]; goto L3; }
-    setcell(CONS,ap2(tl[tl[hd[arg1]]],lexstate(lastarg),ap(DESTREV,hd[hold])),
-		 cons(tl[hd[hd[arg1]]]?tl[hd[hd[arg1]]]-1:arg2,tl[hold]));
+    setcell(CONS,ap2(tl[tl[hd[arg1]]],lexstate(lastarg),lexeme(lastarg,arg3)),
+		 cons(tl[hd[hd[arg1]]]?tl[hd[hd[arg1]]]-1:arg2,hold));
 	        /* tl[scstuff] is 1 + next start condition (0 = no change) */
     goto DONE;
 
-    case DESTREV:  /* destructive reverse - used only by LEX_TRY */
+    case DESTREV:  /* destructive reverse - used only by g_residue */
     GETARG(arg1);  /* known to be an explicit list */
     arg2=NIL; /* to hold reversed list */
     while(arg1!=NIL)
@@ -1329,136 +2098,6 @@ L3: if(arg1==NIL)lexfail(lastarg);
     tl[arg1]=tl[tl[arg1]];
     goto DONE;
 
-#define lh(x) (tag[hd[x]]==STRCONS?tl[hd[x]]:hd[x])
-  /* hd char of possibly lex-state-labelled string */
-
-    case LEX_STRING: /*  LEX_STRING [] p x => p : x
-			 LEX_STRING (c:s) p (c:x) => LEX_STRING s (c:p) x
-			 LEX_STRING (c:s) p other => []
-		     */
-    GETARG(arg1);
-    GETARG(arg2);
-    upleft;
-    while(arg1!=NIL)
-         { if((lastarg=reduce(lastarg))==NIL||lh(lastarg)!=hd[arg1]) /* ### */
-             { hd[e]=I; e=tl[e]=NIL; goto DONE; }
-	   arg1=tl[arg1]; arg2=cons(hd[lastarg],arg2); lastarg=tl[lastarg]; }
-    tag[e]=CONS; hd[e]=arg2;
-    goto DONE;
-
-    case LEX_CLASS: /* LEX_CLASS set p (c:x) => (c:p) : x, if c in set
-		       LEX_CLASS set p   x   => [], otherwise
-		    */
-    GETARG(arg1);
-    GETARG(arg2);
-    upleft;
-    if((lastarg=reduce(lastarg))==NIL||         /* ### */
-       (hd[arg1]==ANTICHARCLASS?memclass(lh(lastarg),tl[arg1])
-                               :!memclass(lh(lastarg),arg1))
-      )
-             { hd[e]=I; e=tl[e]=NIL; goto DONE; }
-    setcell(CONS,cons(hd[lastarg],arg2),tl[lastarg]);
-    goto DONE;
-
-    case LEX_DOT: /* LEX_DOT p (c:x) => (c:p) : x
-		     LEX_DOT p  []   => []
-		  */
-    GETARG(arg1);
-    upleft;
-    if((lastarg=reduce(lastarg))==NIL)    /* ### */
-             { hd[e]=I; e=tl[e]=NIL; goto DONE; }
-    setcell(CONS,cons(hd[lastarg],arg1),tl[lastarg]);
-    goto DONE;
-
-    case LEX_CHAR: /* LEX_CHAR c p (c:x) => (c:p) : x
-		      LEX_CHAR c p  x    => []
-		   */
-    GETARG(arg1);
-    GETARG(arg2);
-    upleft;
-    if((lastarg=reduce(lastarg))==NIL||lh(lastarg)!=arg1)    /* ### */
-             { hd[e]=I; e=tl[e]=NIL; goto DONE; }
-    setcell(CONS,cons(arg1,arg2),tl[lastarg]);
-    goto DONE;
-
-    case LEX_SEQ:  /* LEX_SEQ f g p x => [], if f p x = []
-				      => g q y, otherwise
-					 where
-					 (q,y) = f p x
-		   */
-    GETARG(arg1);
-    GETARG(arg2);
-    GETARG(arg3);
-    upleft;
-    hold=ap2(arg1,arg3,lastarg);
-    lastarg=NIL; /* anti-dragging measure */
-    if((hold=reduce(hold))==NIL)     /* ### */
-      { hd[e]=I; e=tl[e]; goto DONE; }
-    hd[e]=ap(arg2,hd[hold]); tl[e]=tl[hold];
-    DOWNLEFT;
-    DOWNLEFT;
-    goto NEXTREDEX;
-
-    case LEX_OR: /* LEX_OR f g p x => g p x, if f p x = []
-				   => f p x, otherwise
-		 */
-    GETARG(arg1);
-    GETARG(arg2);
-    GETARG(arg3);
-    upleft;
-    hold=ap2(arg1,arg3,lastarg);
-    if((hold=reduce(hold))==NIL)        /* ### */
-      { hd[e]=ap(arg2,arg3); DOWNLEFT; DOWNLEFT; goto NEXTREDEX; }
-    hd[e]=I; e=tl[e]=hold;
-    goto DONE;
-
-    case LEX_RCONTEXT: /* LEX_RC f g p x => [], if f p x = []
-					 => [], if g q y = []
-					 => f p x, otherwise  <-*
-			                    where
-			                    (q,y) = f p x
-
-			 (*) special case g=0 means test for y=[]
-		       */
-    GETARG(arg1);
-    GETARG(arg2);
-    GETARG(arg3);
-    upleft;
-    hold=ap2(arg1,arg3,lastarg);
-    lastarg=NIL; /* anti-dragging measure */
-    if((hold=reduce(hold))==NIL     /* ### */
-       || (arg2?(reduce(ap2(arg2,hd[hold],tl[hold]))==NIL)   /* ### */
-	      :(tl[hold]=reduce(tl[hold]))!=NIL ))
-      { hd[e]=I; e=tl[e]; goto DONE; }
-    hd[e]=I; e=tl[e]=hold;
-    goto DONE;
-
-    case LEX_STAR: /* LEX_STAR f p x => p : x, if f p x = []
-				     => LEX_STAR f q y, otherwise
-					where
-					(q,y) = f p x
-		   */
-    GETARG(arg1);
-    GETARG(arg2);
-    upleft;
-    hold=ap2(arg1,arg2,lastarg);
-    while((hold=reduce(hold))!=NIL)   /* ### */
-         arg2=hd[hold],lastarg=tl[hold],hold=ap2(arg1,arg2,lastarg);
-    tag[e]=CONS; hd[e]=arg2;
-    goto DONE;
-
-    case LEX_OPT: /* LEX_OPT f p x => p : x, if f p x = []
-				   => f p x, otherwise
-		   */
-    GETARG(arg1);
-    GETARG(arg2);
-    upleft;
-    hold=ap2(arg1,arg2,lastarg);
-    if((hold=reduce(hold))==NIL)   /* ### */
-      { tag[e]=CONS; hd[e]=arg2; goto DONE; }
-    hd[e]=I; e=tl[e]=hold;
-    goto DONE;
-
 /*  case NUMBER:   /* constructor of arity 1
     UPLEFT;  /* cannot occur free
     goto DONE; */ /* UNUSED*/
@@ -1531,6 +2170,8 @@ L3: if(arg1==NIL)lexfail(lastarg);
       case INT:
       case UNICODE:
       case DOUBLE:
+      case ARRAY:
+      case HAMT:
       case CONS:; /* all fall thru to DONE */
     }
 
@@ -1600,6 +2241,11 @@ L3: if(arg1==NIL)lexfail(lastarg);
     hd[e]=I;e=lastarg;
     goto NEXTREDEX;
 
+    case READY(SORT):      /*  SORT x => x in ascending order, stably */
+    UPLEFT;
+    hd[e]=I; e=tl[e]=sortlist(lastarg);      /* ### */
+    goto DONE;
+
     case READY(HD):
     UPLEFT;
     if(lastarg==NIL)
@@ -1700,6 +2346,7 @@ L3: if(arg1==NIL)lexfail(lastarg);
 			   shell command, returning (via pipes) the
 			   triple (stdout,stderr,exit_status)
 			   convention: if fork fails, exit status is -1 */
+    if(sparkchild)_exit(1);  /* see spark() */
     UPLEFT;
     { int pid=(-1),fd[2],fd_a[2];
       char *cp=getstring(lastarg,"system");
@@ -2217,16 +2864,96 @@ L3: if(arg1==NIL)lexfail(lastarg);
 
 }  /* end of reduce */
 
-int memclass(c,x) /* is char c in list x (may include ranges) */
-int c; word x;
-{ while(x!=NIL)
-       { if(hd[x]==DOTDOT)
-           { x=tl[x];
-             if(hd[x]<=c&&c<=hd[tl[x]])return(1);
-             x=tl[x]; }
-         else if(c==hd[x])return(1);
+#define lh(x) (tag[hd[x]]==STRCONS?tl[hd[x]]:hd[x])
+  /* hd char of possibly lex-state-labelled string */
+#define lexforce(x) (tag[x]==CONS||(x)==NIL?(x):reduce(x))
+
+word lexmatch(r,x,n) /* regular expression r from %lex applied to input x,
+                        returns rest of x, or 0 if r fails; *n is increased
+                        by the number of chars matched */
+word r,x,*n;
+/* the semantics are those of the combinators once used as matchers -
+   each returns on success the input after the chars it consumes
+        LEX_DOT (c:x) => x
+        LEX_CHAR c (c:x) => x
+        LEX_STRING s x => y, if x = s ++ y
+        LEX_CLASS set (c:x) => x, if c in set (see charset)
+        LEX_SEQ f g x => g (f x)
+        LEX_OR f g x => f x, if f succeeds
+                     => g x, otherwise
+        LEX_RCONTEXT f g x => f x, if g succeeds on f x (g=0: if f x = [])
+        LEX_STAR f x => LEX_STAR f (f x), if f succeeds
+                     => x, otherwise
+        LEX_OPT f x => f x, if f succeeds
+                    => x, otherwise
+   in all other cases failure.  Note that `|' commits to the first
+   alternative that succeeds and `*' never gives back what it has taken,
+   so there is no backtracking - each rule is a single left to right scan.
+*/
+{ word y,m;
+  L: if(r==LEX_DOT)
+       { if((x=lexforce(x))==NIL)return(0);  /* ### */
+         ++*n;
+         return(tl[x]); }
+  switch(tag[hd[r]]==AP?hd[hd[r]]:hd[r])
+  { case LEX_CHAR:
+         if((x=lexforce(x))==NIL||lexch(x)!=tl[r])return(0);  /* ### */
+         ++*n;
+         return(tl[x]);
+    case LEX_STRING:
+         for(y=tl[r];y!=NIL;y=tl[y])
+            { if((x=lexforce(x))==NIL||lexch(x)!=hd[y])return(0);  /* ### */
+              ++*n;
+              x=tl[x]; }
+         return(x);
+    case LEX_CLASS:
+         if((x=lexforce(x))==NIL)return(0);  /* ### */
+         if(!inset(lexch(x),tl[r]))return(0);
+         ++*n;
+         return(tl[x]);
+    case LEX_STAR:
+         m= *n;
+         while((y=lexmatch(tl[r],x,n)))x=y,m= *n;
+         *n=m;
+         return(x);
+    case LEX_OPT:
+         m= *n;
+         if((y=lexmatch(tl[r],x,n)))return(y);
+         *n=m;
+         return(x);
+    case LEX_SEQ:
+         if(!(x=lexmatch(tl[hd[r]],x,n)))return(0);
+         r=tl[r]; goto L;
+    case LEX_OR:
+         m= *n;
+         if((y=lexmatch(tl[hd[r]],x,n)))return(y);
+         *n=m;
+         r=tl[r]; goto L;
+    case LEX_RCONTEXT:
+         if(!(x=lexmatch(tl[hd[r]],x,n)))return(0);
+         if(tl[r])return(m=0,lexmatch(tl[r],x,&m)?x:0);
+         return(lexforce(x)==NIL?x:0);  /* ### */
+    default: fprintf(stderr,"impossible event in lexmatch\n");
+             exit(1);
+  }
+}
+
+word lexch(x) /* char at front of evaluated non-empty list x, forcing it */
+word x;
+{ word *p = tag[hd[x]]==STRCONS?&tl[hd[x]]:&hd[x];
+  if(tag[*p]==AP)*p=reduce(*p);  /* ### */
+  return(*p);
+}
+
+word lexeme(x,n) /* first n chars of x, which lexmatch has evaluated */
+word x,n;
+{ word s=NIL,*p= &s;
+  while(n--)
+       { x=lexforce(x);
+         *p=cons(lh(x),NIL);
+         p= &tl[*p];
          x=tl[x]; }
-  return(0);
+  return(s);
 }
 
 void lexfail(x)  /* x is known to be a non-empty string (see LEX_RPT) */
@@ -2253,6 +2980,404 @@ word pid;
 { return(str_conv(pid== -1?"cannot create process\n":"cannot open pipe\n"));
 }
 
+/* packrat parsing: the result of each nonterminal (G_MEMO f) at each token
+   position is kept in a hash table indexed by (f,toks), so a backtracking
+   grammar tries each nonterminal at most once per position.  toks is
+   whatever list cell the nonterminal was applied to - as the token stream
+   is evaluated in place (see G_COUNT) the same position is normally the
+   same cell, and a miss merely costs a reevaluation.  The table is not a
+   root for the garbage collector - memo_mark() is called at the end of
+   bases() and drops entries whose f or toks has become garbage, marking
+   the results of the others. */
+
+struct memo { word f,toks,val; };
+static struct memo *memotab=NULL;
+static word memosize=0,memocount=0;
+
+word memohash(f,toks)
+word f,toks;
+{ return (word)(((unsigned long)f*31+toks)*0x9E3779B97F4A7C15UL>>7)&(memosize-1);
+}
+
+word memo_find(f,toks) /* returns 0 if not present */
+word f,toks;
+{ word i;
+  if(memocount==0)return(0);
+  for(i=memohash(f,toks);memotab[i].f;i=(i+1)&(memosize-1))
+     if(memotab[i].f==f&&memotab[i].toks==toks)return(memotab[i].val);
+  return(0);
+}
+
+void memo_rehash(n) /* n is a power of 2 */
+word n;
+{ struct memo *old=memotab;
+  word oldsize=memosize,i,j;
+  memotab=(struct memo *)calloc(n,sizeof(struct memo));
+  if(memotab==NULL)mallocfail("packrat table");
+  memosize=n;
+  memocount=0;
+  for(i=0;i<oldsize;i++)
+     if(old[i].f)
+       { for(j=memohash(old[i].f,old[i].toks);memotab[j].f;j=(j+1)&(memosize-1))
+              ;
+         memotab[j]=old[i];
+         memocount++; }
+  free(old);
+}
+
+void memo_put(f,toks,val)
+word f,toks,val;
+{ word i;
+  if(2*(memocount+1)>memosize)memo_rehash(memosize?2*memosize:1024);
+  for(i=memohash(f,toks);memotab[i].f;i=(i+1)&(memosize-1));
+  memotab[i].f=f,memotab[i].toks=toks,memotab[i].val=val;
+  memocount++;
+}
+
+/* memo f (MEMO) remembers f x for each x it is applied to, in a second
+   hash table indexed by the memo function - the cell ap(ap(MEMO,n),f) -
+   and by x, which is evaluated completely to be hashed (see hashval) and
+   matched with compare().  Entries are malloc'd and linked by pointer, not
+   by index - a small index left in a stack frame would be taken for a
+   cell by bases(), and could hold on to a long list.  Those of each memo
+   function are on a circular list in order of use, whose head is an entry
+   with x the function itself holding their count and the bound n - beyond
+   n>0 entries the least recently used is dropped.  The table is not a root
+   for the garbage collector, entries live as long as their function does,
+   see memo_mark(). */
+
+struct fmemo { word f,x,val,count,bound;
+               unsigned long h;
+               struct fmemo *chain,*newer,*older,*head; };
+static struct fmemo **fmhash=NULL;
+static word fmcount=0,fmhsize=0;
+
+#define fmslot(f,h) \
+        ((((unsigned long)(f)*31+(h))*0x9E3779B97F4A7C15UL>>7)&(fmhsize-1))
+
+void fm_rehash(n) /* n is a power of 2 */
+word n;
+{ struct fmemo **old=fmhash,*p,*q;
+  word i,oldsize=fmhsize;
+  fmhash=(struct fmemo **)calloc(n,sizeof(struct fmemo *));
+  if(fmhash==NULL)mallocfail("memo table");
+  fmhsize=n;
+  for(i=0;i<oldsize;i++)
+     for(p=old[i];p;p=q)
+        q=p->chain,
+        p->chain=fmhash[fmslot(p->f,p->h)],fmhash[fmslot(p->f,p->h)]=p;
+  free(old);
+}
+
+struct fmemo *fm_new(f,x,h) /* a new entry, chained but not on a list of uses */
+word f,x;
+unsigned long h;
+{ struct fmemo *p;
+  if(++fmcount>fmhsize)fm_rehash(fmhsize?2*fmhsize:1024);
+  p=(struct fmemo *)malloc(sizeof(struct fmemo));
+  if(p==NULL)mallocfail("memo table");
+  p->f=f,p->x=x,p->h=h,p->val=NIL;
+  p->chain=fmhash[fmslot(f,h)],fmhash[fmslot(f,h)]=p;
+  return(p);
+}
+
+#define fm_unuse(p) ((p)->older->newer=(p)->newer,(p)->newer->older=(p)->older)
+#define fm_use(hd,p) ((p)->older=(hd)->older,(p)->newer=(hd), \
+                      (hd)->older->newer=(p),(hd)->older=(p))
+
+word fm_find(f,x,h) /* f x if remembered, else 0 - h is the hash of x */
+word f,x;
+unsigned long h;
+{ struct fmemo *p;
+  if(fmcount==0)return(0);
+  for(p=fmhash[fmslot(f,h)];p;p=p->chain)
+     if(p->f==f&&p->h==h&&p->x!=f&&compare(p->x,x)==0)
+       { if(p->head->bound)fm_unuse(p),fm_use(p->head,p);
+         return(p->val); }
+  return(0);
+}
+
+void fm_put(f,x,h,val,n) /* remember val as f x, f having bound n */
+word f,x,val,n;
+unsigned long h;
+{ struct fmemo *hd=NULL,*p,**pp;
+  if(fmcount)
+    for(hd=fmhash[fmslot(f,0)];hd;hd=hd->chain)
+       if(hd->f==f&&hd->x==f)break;
+  if(hd==NULL)
+    { hd=fm_new(f,f,0);
+      hd->newer=hd->older=hd;
+      hd->count=0,hd->bound=n; }
+  if(hd->bound&&hd->count==hd->bound)
+    { p=hd->newer; /* least recently used */
+      fm_unuse(p);
+      for(pp=fmhash+fmslot(f,p->h);*pp!=p;pp= &(*pp)->chain);
+      *pp=p->chain;
+      free(p),fmcount--;
+      hd->count--; }
+  p=fm_new(f,x,h);
+  p->val=val,p->head=hd;
+  fm_use(hd,p);
+  hd->count++;
+}
+
+#define marked(x) (!isptr(x)||!(tag[x]&128)) /* see gc() */
+
+void memo_mark() /* called from bases(), see above */
+{ extern word SPACE;
+  struct fmemo *p,**pp;
+  word i,more=1;
+  if(memocount==0&&fmcount==0)return;
+  while(more) /* marking a result may bring other positions to life */
+     { for(more=0,i=0;i<memosize;i++)
+          if(memotab[i].f&&marked(memotab[i].f)&&marked(memotab[i].toks)
+             &&!marked(memotab[i].val))
+            mark(memotab[i].val),more=1;
+       for(i=0;i<fmhsize;i++)
+          for(p=fmhash[i];p;p=p->chain)
+             if(p->x!=p->f&&marked(p->f)&&!(marked(p->x)&&marked(p->val)))
+               mark(p->x),mark(p->val),more=1; }
+  for(i=0;i<memosize;i++)
+     if(memotab[i].f&&!(marked(memotab[i].f)&&marked(memotab[i].toks)))
+       memotab[i].f=0;
+  if(memocount)memo_rehash(memosize); /* removes the gaps */
+  for(i=0;i<fmhsize;i++) /* a dead function takes all its entries with it */
+     for(pp=fmhash+i;p= *pp;)
+        if(marked(p->f))pp= &p->chain;
+        else *pp=p->chain,free(p),fmcount--;
+}
+
+/* par a b (PAR) is b, but hands a meanwhile to another processor.  The
+   heap cannot be shared, so a child process is forked, with a copy of it,
+   to evaluate a completely and send the result back down a pipe, see
+   send_val() in data.c.  In the parent the cell a becomes SPARK k a', a'
+   a copy of what a was, so that when a is needed the parent takes the
+   value the child has sent, or evaluates a' itself if the child could not
+   send one - a is a function, or undefined, or reads input, which must be
+   left to the parent.  If the child has not finished when a is needed the
+   parent waits for it, a child evaluating an infinite a failing in time
+   for want of heap.  A child whose a is never needed is killed, as is one
+   left when the parent is interrupted.  There are at most as many children as processors
+   less one, beyond that par does nothing, as it does in a child.  Each is
+   known by its token k, an INT cell, and is killed once k is garbage, see
+   spark_reap(). */
+
+struct spark { word k; int fd; pid_t pid; };
+static struct spark *sparks=NULL;
+static word nsparks= -1;
+word sparked=0; /* see bases() in data.c */
+
+void spark(a)
+word a;
+{ word i,k,c;
+  int fd[2];
+  pid_t pid;
+  if(nsparks<0)
+    { nsparks=sysconf(_SC_NPROCESSORS_ONLN)-1;
+      if(nsparks<0)nsparks=0;
+      sparks=(struct spark *)calloc(nsparks+1,sizeof(struct spark));
+      if(sparks==NULL)mallocfail("sparks");
+      atexit(spark_stop); }
+  while(tag[a]==ID)a=id_val(a);
+  if(sparkchild||tag[a]!=AP||hd[a]==I||tag[hd[a]]==AP&&hd[hd[a]]==SPARK)
+    return;
+  for(i=0;i<nsparks&&sparks[i].k;i++);
+  if(i==nsparks||pipe(fd)== -1)return;
+  fflush(NULL); /* or the child might write what is buffered a second time */
+  if((pid=fork())== -1){ close(fd[0]),close(fd[1]); return; }
+  if(pid==0)
+    { int null=open("/dev/null",O_WRONLY);
+      (void)signal(SIGINT,SIG_DFL);
+      close(fd[0]);
+      if(null>=0)dup2(null,1),dup2(null,2); /* errors are left to the parent */
+      sparkchild=1;
+      a=reduce(a);  /* ### */
+      force(a);  /* ### */
+      _exit(!send_val(fd[1],a)); }
+  close(fd[1]);
+  sparked=1;
+  k=sto_int(pid);
+  c=ap(hd[a],tl[a]);
+  sparks[i].k=k,sparks[i].fd=fd[0],sparks[i].pid=pid;
+  hd[a]=ap(SPARK,k);
+  tl[a]=c;
+}
+
+word spark_val(k,v) /* the value sent by the child of SPARK k, in *v, waiting
+                       for it to finish - returns 0 if it could not send one */
+word k,*v;
+{ word i,r;
+  if(sparkchild)return(0);
+  for(i=0;i<nsparks&&sparks[i].k!=k;i++);
+  if(i>=nsparks)return(0);
+  r=recv_val(sparks[i].fd,v);  /* ### */
+  spark_kill(i); /* has finished, or died */
+  return(r>0);
+}
+
+void spark_kill(i)
+word i;
+{ kill(sparks[i].pid,SIGKILL);
+  close(sparks[i].fd);
+  waitpid(sparks[i].pid,NULL,0);
+  sparks[i].k=0;
+}
+
+/* parmap n f x (PARMAP) is a strict map f x, f applied by n worker processes
+   forked for it.  The elements of x are evaluated completely and sent to
+   the workers in chunks, round-robin, and the results sent back as by
+   spark() and read in order - PARMAP1 f k q x' is the rest of the result,
+   k the token of the workers, q the chunks sent and not yet read, as pairs
+   (worker,chunk), and x' the rest of x.  Each worker has at most one chunk
+   at a time, so neither end of a pipe waits for the other, and is sent
+   the next as its result is read.  A chunk that cannot be sent, or whose
+   result cannot be sent back (the worker has died, on an error say), is
+   mapped by the parent, with -1-worker in place of worker in q - so the
+   result is that of map f x when the elements of x and of the result are
+   finite and defined.  Unlike map, parmap is strict in both, evaluating
+   elements up to n chunks ahead of demand.  Chunks start at one element
+   and grow to PMCHUNK, see pm_send(). */
+
+#define PMCHUNK 64
+struct pmap { word k,n,sent; pid_t *pid; int *in,*out; };
+static struct pmap *pmaps=NULL;
+static word npmaps=0;
+
+void pm_worker(in,out,f) /* never returns */
+int in,out;
+word f;
+{ word x;
+  while(recv_val(in,&x)>0)
+       { x=reduce(ap2(MAP,f,x));  /* ### */
+         force(x);  /* ### */
+         if(!send_val(out,x))send_none(out); }
+  _exit(0);
+}
+
+word pm_new(n,f) /* index in pmaps of n workers for f, -1 if none */
+word n,f;
+{ word i,w;
+  int in[2],out[2];
+  pid_t pid;
+  if(sparkchild||n<1)return(-1);
+  if(npmaps==0)atexit(spark_stop);
+  for(i=0;i<npmaps&&pmaps[i].k;i++);
+  if(i==npmaps)
+    { pmaps=(struct pmap *)realloc(pmaps,++npmaps*sizeof(struct pmap));
+      if(pmaps==NULL)mallocfail("parmap"); }
+  pmaps[i].pid=(pid_t *)malloc(n*sizeof(pid_t));
+  pmaps[i].in=(int *)malloc(n*sizeof(int));
+  pmaps[i].out=(int *)malloc(n*sizeof(int));
+  if(!pmaps[i].pid||!pmaps[i].in||!pmaps[i].out)mallocfail("parmap");
+  fflush(NULL); /* see spark() */
+  for(w=0;w<n;w++)
+     { if(pipe(in)== -1)break;
+       if(pipe(out)== -1){ close(in[0]),close(in[1]); break; }
+       if((pid=fork())== -1)
+         { close(in[0]),close(in[1]),close(out[0]),close(out[1]); break; }
+       if(pid==0)
+         { int null=open("/dev/null",O_WRONLY),j;
+           (void)signal(SIGINT,SIG_DFL);
+           for(j=0;j<w;j++)close(pmaps[i].in[j]),close(pmaps[i].out[j]);
+           close(in[1]),close(out[0]);
+           if(null>=0)dup2(null,1),dup2(null,2);
+           sparkchild=1;
+           pm_worker(in[0],out[1],f); }
+       close(in[0]),close(out[1]);
+       pmaps[i].pid[w]=pid,pmaps[i].in[w]=in[1],pmaps[i].out[w]=out[0]; }
+  if(w==0)
+    { free(pmaps[i].pid),free(pmaps[i].in),free(pmaps[i].out);
+      pmaps[i].k=0;
+      return(-1); }
+  pmaps[i].n=w,pmaps[i].sent=0;
+  sparked=1;
+  pmaps[i].k=sto_int(w);
+  return(i);
+}
+
+word pm_start(n,f,xp) /* PARMAP1 f k q, n workers having been started and
+                         sent the first chunks of *xp - or 0 if none were */
+word n,f,*xp;
+{ word i=pm_new(n,f),w,c,q=NIL;
+  if(i<0)return(0);
+  for(w=0;w<pmaps[i].n&&(c=pm_send(i,w,xp))!=NIL;w++)  /* ### */
+     q=cons(c,q);
+  return(ap3(PARMAP1,f,pmaps[i].k,reverse(q)));
+}
+
+word pm_find(k) /* index in pmaps of the workers with token k, or -1 */
+word k;
+{ word i;
+  if(sparkchild)return(-1);
+  for(i=0;i<npmaps;i++)if(pmaps[i].k==k)return(i);
+  return(-1);
+}
+
+word pm_send(i,w,xp) /* the next chunk of *xp, sent to worker w if possible,
+                        as an entry of q - NIL if *xp is [] */
+word i,w,*xp;
+{ word c=NIL,n=0,size=pmaps[i].sent/pmaps[i].n,x= *xp;
+  sighandler oldsig;
+  size=size<6?1<<size:PMCHUNK;
+  while(n<size&&(x=reduce(x))!=NIL)  /* ### */
+       { hd[x]=reduce(hd[x]);  /* ### */
+         force(hd[x]);  /* ### */
+         c=cons(hd[x],c);
+         x=tl[x],n++; }
+  *xp=x;
+  if(c==NIL)return(NIL);
+  c=reverse(c);
+  pmaps[i].sent++;
+  if(pmaps[i].in[w]>=0)
+    { oldsig=signal(SIGPIPE,SIG_IGN); /* a worker may have died */
+      n=send_val(pmaps[i].in[w],c);
+      (void)signal(SIGPIPE,oldsig);
+      if(n)return(cons(sto_int(w),c)); }
+  return(cons(sto_int(-1-w),c));
+}
+
+static void pm_close(i,w) /* worker w is finished with */
+word i,w;
+{ if(pmaps[i].in[w]<0)return;
+  close(pmaps[i].in[w]),close(pmaps[i].out[w]);
+  kill(pmaps[i].pid[w],SIGKILL);
+  waitpid(pmaps[i].pid[w],NULL,0);
+  pmaps[i].in[w]=pmaps[i].out[w]= -1;
+}
+
+word pm_recv(i,w,v) /* the result of worker w, in *v - returns 0 if none */
+word i,w,*v;
+{ word r=pmaps[i].out[w]<0?-1:recv_val(pmaps[i].out[w],v);
+  if(r<0)pm_close(i,w); /* it has died */
+  return(r>0);
+}
+
+void pm_kill(i)
+word i;
+{ word w;
+  for(w=0;w<pmaps[i].n;w++)pm_close(i,w);
+  free(pmaps[i].pid),free(pmaps[i].in),free(pmaps[i].out);
+  pmaps[i].k=0;
+}
+
+void spark_reap() /* called by gc() after marking */
+{ extern word SPACE;
+  word i;
+  for(i=0;i<nsparks;i++)
+     if(sparks[i].k&&!marked(sparks[i].k))spark_kill(i);
+  for(i=0;i<npmaps;i++)
+     if(pmaps[i].k&&!marked(pmaps[i].k))pm_kill(i);
+}
+
+void spark_stop() /* at exit, children still working are not wanted */
+{ word i;
+  if(sparkchild)return;
+  for(i=0;i<nsparks;i++)
+     if(sparks[i].k)spark_kill(i);
+  for(i=0;i<npmaps;i++)
+     if(pmaps[i].k)pm_kill(i);
+}
+
 word g_residue(toks2)  /* remainder of token stream from last token examined */
 word toks2;
 { word toks1 = NIL;
@@ -2348,6 +3473,19 @@ start=clock();
 #endif
 }
 
+static long gcbase=0;
+static struct timespec wallstart;
+static int walltimed=0;
+
+void resetstats() /* statistics from now on only - for each request of mira
+                     -serve, whose reply ends with them, with elapsed time */
+{ extern long claims,nogcs;
+  extern long long cellcount;
+  cycles=0,cellcount= -claims,gcbase=nogcs;
+  initclock();
+  clock_gettime(CLOCK_MONOTONIC,&wallstart),walltimed=1;
+}
+
 void out_here(f,h,nl)  /* h is fileinfo(scriptname,line_no) */
 FILE *f;
 word h,nl;
@@ -2378,12 +3516,17 @@ void outstats()
   printf("||");
   printf("reductions = %lld, cells claimed = %lld, ",
 		cycles,cellcount+claims);
-  printf("no of gc's = %ld, cpu = %0.2f",nogcs,
+  printf("no of gc's = %ld, cpu = %0.2f",nogcs-gcbase,
 #ifdef BSDCLOCK
 	    buffer.tms_utime/(CLK_TCK*1.0));
 #else
             ((double) (end - start)) / CLOCKS_PER_SEC);
 #endif
+  if(walltimed)
+    { struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC,&now);
+      printf(", elapsed = %0.3f",(now.tv_sec-wallstart.tv_sec)+
+                                 (now.tv_nsec-wallstart.tv_nsec)/1e9); }
   putchar('\n');
 #ifdef DEBUG
   printf("||maxr_depth=%d\n",maxrdepth);
@@ -120,6 +120,7 @@ word x;
   lastexp=x;
   x=codegen(x);
   if(polyshowerror)return;
+  if(pool_eval())return;  /* evaluated by a pre-forked process, see /workers */
   if(process())
                  /* setup new process for each evaluation */
   { (void)signal(SIGINT,(sighandler)dieclean);
@@ -900,9 +901,9 @@ lunit:
     CHARCLASS
         = { if($1==NIL)
               syntax("empty character class `` cannot match\n");
-            $$ = tl[$1]==NIL?ap(LEX_CHAR,hd[$1]):ap(LEX_CLASS,$1); }|
+            $$ = tl[$1]==NIL?ap(LEX_CHAR,hd[$1]):ap(LEX_CLASS,charset($1,0)); }|
     ANTICHARCLASS
-        = { $$ = ap(LEX_CLASS,cons(ANTICHARCLASS,$1)); }|
+        = { $$ = ap(LEX_CLASS,charset($1,1)); }|
     '.'
         = { $$ = LEX_DOT; }|
     name
@@ -1107,6 +1108,8 @@ def:
               printf("%sfatal error in grammar, ",echoing?"\n":""),
               printlist("irremovable left recursion: ",leftrecs),
               acterror();
+            for(p=$6;p!=NIL;p=tl[p]) /* for -packrat, see G_MEMO */
+               dval(hd[p])=ap(G_MEMO,dval(hd[p]));
             if($4==NIL) /* implied start symbol */
               $4=cons(dlhs(hd[lastlink($6)]),NIL);
             fnts=1; /* fnts is flag indicating %bnf in use */
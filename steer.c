@@ -23,6 +23,11 @@
 #include <ctype.h>   /* For isalpha */
 #include <termios.h> /* For struct winsize, TIOCGWINSZ */
 #include <sys/ioctl.h> /* For ioctl */
+#include <sys/socket.h> /* For socket, bind, listen, accept (-serve) */
+#include <sys/un.h>  /* For struct sockaddr_un */
+#include <errno.h>
+#include <sys/mman.h> /* For mmap (heap image) */
+#include <time.h>    /* For clock_gettime (-timings) */
 
 #if defined(sparc8) || defined(sparc)
 #include <ieeefp.h>
@@ -52,6 +57,7 @@ word shownum1, showbool, showchar, showlist, showstring, showparen, showpair,
  * Consider using dynamic allocation with error checking for robust path handling. */
 char PRELUDE[pnlim + 10];
 char STDENV[pnlim + 9];
+char IMAGE[pnlim + 11]; /* heap image, see -snapshot */
 
 #define DFLTSPACE 2500000L
 #define DFLTDICSPACE 100000L
@@ -74,12 +80,17 @@ int UTF8OUT = 0;
 extern char *vdate, *host;
 extern word version, ND;
 extern word *dstack, *stackp;
+struct tstamp { double wall, cpu; long long cells; long gcs; }; /* see tstart() */
 
 /* Forward declarations for static functions */
 static void allnamescom(void);
+static void cachecp(const char *, const char *);
+static unsigned long long cachekey(const char *, int);
+static int cachename(char *, size_t, const char *);
 static void announce(void);
 static int badeditor(void);
 static int checkversion(char *);
+static void childstatus(int);
 static void command(void);
 static void commandloop(char *);
 static void diagnose(const char *);
@@ -91,6 +102,11 @@ static void finger(const char *);
 static void fixeditor(void);
 static void fixexports(void);
 static int getln(FILE *, word, char *);
+static void imgfiles(void);
+static int imgload(char *);
+static int litscript(const char *, FILE *);
+static void imgmark(void);
+static void imgsave(char *);
 static word isfreeid(word);
 static void libfails(void);
 static void loadfile(char *);
@@ -100,6 +116,10 @@ static void mira_setup(void);
 static void missparam(const char *);
 static char *mkabsolute(char *);
 static word mkincludes(word);
+static void mkparallel(int, char **);
+static int mkscan(const char *);
+static void mkscanfile(int, const char *, int);
+static int scandirective(const char *, char *, int, char *);
 static word mktiny(void);
 static void namescom(word);
 static void primlib(void);
@@ -107,10 +127,20 @@ static word privatise(word);
 static void privlib(void);
 static word publicise(word);
 static word rc_read(char *);
+static void pool_fill(void);
+static void pool_flush(void);
+static void pool_worker(int);
+static void pretouch(void);
 static void rc_write(void);
+static int rv_char(void);
+static int rv_getline(FILE *);
+static int rv_resolve(word *, word *);
+static word rv_val(word, word, int);
+static void serve(char *, char *);
 static int src_update(void);
 static void stdlib(void);
 static const char *strvers(int);
+static void tnow(struct tstamp *);
 static int twidth(void);
 static void undump(char *);
 static int utf8test(void);
@@ -138,11 +168,32 @@ const char *obsuffix = "x";
 FILE *s_in = NULL;
 extern word commandmode; /* true only when reading command-level expressions */
 int atobject = 0, atgc = 0, atcount = 0, debug = 0;
+int attimings = 0; /* 1 reports each phase of compilation, 2 does so in JSON */
+int packrat = 0;   /* %bnf parsers remember their results, see G_MEMO */
+int typecache = 0; /* types of unchanged definitions are reused, see tcswap */
+int partypes = 0;  /* types are inferred by worker processes, see tw_plan */
+int gcthreads = 1; /* threads marking the heap, see gcmark() */
 word magic = 0; /* set to 1 means script will start with UNIX magic string */
 word making = 0; /* set only for mira -make */
 word mkexports = 0; /* set only for mira -exports */
 word mksources = 0; /* set only for mira -sources */
 word make_status = 0; /* exit status of -make */
+int makejobs = 1; /* processes used by -make, see mkparallel() */
+char *servepath = NULL; /* socket named by -serve */
+char *cachedir = NULL; /* compile cache, see cachename() */
+word snapshot = 0; /* set only for mira -snapshot */
+word serving = 0; /* set in a worker forked by serve() or the /workers pool */
+#define MAXWORKERS 64
+#define PRETOUCH 32768 /* cells touched by each worker, see pretouch() */
+int nworkers = 0; /* size of pool of evaluation processes, set by /workers */
+static struct { pid_t pid; int fd; } pool[MAXWORKERS];
+static int npool = 0;
+static char *poolline = NULL; /* expression being compiled, see commandloop */
+static char *rv_buf = NULL; /* line buffer, see rv_getline() */
+#define TDEPTH 16
+static struct tstamp tstack[TDEPTH];
+static int tdepth = 0; /* phases being timed, see tstart() */
+static int rv_size = 0;
 int compiling = 1;
 /* there are two types of MIRANDA process - compiling (the main process) and
 subsidiary processes launched for each evaluation - the above flag tells
@@ -227,7 +278,12 @@ int main(int argc, char *argv[]) {
         else if (strcmp(argv[1], "-nolist") == 0) listing = 0;
         else if (strcmp(argv[1], "-nostrictif") == 0) strictif = 0;
         else if (strcmp(argv[1], "-gc") == 0) atgc = 1;
+        else if (strcmp(argv[1], "-timings") == 0) attimings = 1;
+        else if (strcmp(argv[1], "-timings=json") == 0) attimings = 2;
         else if (strcmp(argv[1], "-object") == 0) atobject = 1;
+        else if (strcmp(argv[1], "-packrat") == 0) packrat = 1;
+        else if (strcmp(argv[1], "-typecache") == 0) typecache = 1;
+        else if (strcmp(argv[1], "-partypes") == 0) partypes = 1;
         else if (strcmp(argv[1], "-lib") == 0) {
             argc--, argv++;
             if (argc == 1) missparam("lib");
@@ -242,6 +298,11 @@ int main(int argc, char *argv[]) {
             if (argc == 1) missparam("heap");
             else if (sscanf(argv[1], "%ld", &SPACELIMIT) != 1 || badval(SPACELIMIT))
                 fprintf(stderr, "mira: bad value after flag \"-heap\"\n"), exit(1);
+        } else if (strcmp(argv[1], "-gcthreads") == 0) {
+            argc--, argv++;
+            if (argc == 1) missparam("gcthreads");
+            else if (sscanf(argv[1], "%d", &gcthreads) != 1 || gcthreads < 1 || gcthreads > 64)
+                fprintf(stderr, "mira: bad value after flag \"-gcthreads\"\n"), exit(1);
         } else if (strcmp(argv[1], "-editor") == 0) {
             argc--, argv++;
             if (argc == 1) missparam("editor");
@@ -289,12 +350,28 @@ int main(int argc, char *argv[]) {
         } else if (strcmp(argv[1], "-make") == 0) {
             making = 1;
             verbosity = 0;
+        } else if (strcmp(argv[1], "-j") == 0) {
+            argc--, argv++;
+            if (argc == 1) missparam("j");
+            else if (sscanf(argv[1], "%d", &makejobs) != 1 || makejobs < 1 || makejobs > 256)
+                fprintf(stderr, "mira: bad value after flag \"-j\"\n"), exit(1);
         } else if (strcmp(argv[1], "-exports") == 0) {
             making = mkexports = 1;
             verbosity = 0;
         } else if (strcmp(argv[1], "-sources") == 0) {
             making = mksources = 1;
             verbosity = 0;
+        } else if (strcmp(argv[1], "-snapshot") == 0) {
+            snapshot = 1;
+            verbosity = 0;
+        } else if (strcmp(argv[1], "-cache") == 0) {
+            argc--, argv++;
+            if (argc == 1) missparam("cache");
+            else cachedir = argv[1];
+        } else if (strcmp(argv[1], "-serve") == 0) {
+            argc--, argv++;
+            if (argc == 1) missparam("serve");
+            else servepath = argv[1], verbosity = 0;
         } else if (strcmp(argv[1], "-UTF-8") == 0) UTF8 = 1;
         else if (strcmp(argv[1], "-noUTF-8") == 0) UTF8 = 0;
         else
@@ -337,6 +414,7 @@ int main(int argc, char *argv[]) {
     if ((prs = getenv("MIRAPROMPT"))) promptstr = prs;
     if (getenv("RECHECKMIRA") && !rechecking) rechecking = 1;
     if (getenv("NOSTRICTIF")) strictif = 0;
+    if (!cachedir) cachedir = getenv("MIRACACHE");
 
     setupdic(); /* used by mkabsolute */
     s_in = stdin;
@@ -351,24 +429,36 @@ int main(int argc, char *argv[]) {
     (void)strcpy(STDENV, miralib);
     (void)strcat(STDENV, "/stdenv.m");
 
+    (void)strcpy(IMAGE, miralib);
+    (void)strcat(IMAGE, "/heapimage");
+
     mira_setup();
+    if (snapshot) {
+        if (nostdenv) fprintf(stderr, "mira: -snapshot needs the standard environment\n"), exit(1);
+        imgmark();
+    }
 
     if (verbosity) announce();
-    files = NIL;
-    undump(PRELUDE);
-    okprel = 1;
-    mkprivate(fil_defs(hd[files]));
-    files = NIL; /* don't wish unload() to unsetids on prelude */
-
-    if (!nostdenv) {
-        undump(STDENV);
-        while (files != NIL) { /* stdenv may have %include structure */
-            primenv = alfasort(append1(primenv, fil_defs(hd[files])));
-            files = tl[files];
+    if (nostdenv || snapshot || !imgload(IMAGE)) {
+        files = NIL;
+        undump(PRELUDE);
+        okprel = 1;
+        mkprivate(fil_defs(hd[files]));
+        if (snapshot) imgfiles();
+        files = NIL; /* don't wish unload() to unsetids on prelude */
+
+        if (!nostdenv) {
+            undump(STDENV);
+            if (snapshot) imgfiles();
+            while (files != NIL) { /* stdenv may have %include structure */
+                primenv = alfasort(append1(primenv, fil_defs(hd[files])));
+                files = tl[files];
+            }
+            primenv = alfasort(primenv);
+            newtyps = files = NIL; /* don't wish unload() to unsetids */
         }
-        primenv = alfasort(primenv);
-        newtyps = files = NIL; /* don't wish unload() to unsetids */
     }
+    if (snapshot) imgsave(IMAGE), exit(0);
 
     if (!magic) rc_write();
     echoing = verbosity & listing;
@@ -440,6 +530,7 @@ int main(int argc, char *argv[]) {
     if (making) {
         extern word oldfiles;
         char *s;
+        if (makejobs > 1 && !mksources) mkparallel(argc - 1, argv + 1);
         setjmp(env); /* will return here on blankerr (via reset) */
         while (--argc) { /* where do error messages go?? */
             s = addextn(1, *++argv);
@@ -487,6 +578,7 @@ int main(int argc, char *argv[]) {
 #endif
     (void)signal(SIGTERM, (sighandler)exit); /* flush buffers if killed */
 
+    if (servepath) serve(servepath, initscript);
     commandloop(initscript);
     /* parameter is file given as argument */
     return 0; /* Should not be reached, commandloop contains infinite loop or exit */
@@ -764,10 +856,12 @@ void commandloop(char *initscript) {
     for (;;) {
         resetgcstats();
         if (verbosity) printf("%s", promptstr);
+        if (npool < nworkers) fflush(stdout), pool_fill(); /* while user types */
         ch = getchar();
-        if (rechecking && src_update()) loadfile(current_script);
+        if (rechecking && src_update()) pool_flush(), loadfile(current_script);
         /* modified behaviour for `2-window' mode */
         while (ch == ' ' || ch == '\t') ch = getchar();
+        if (npool && (ch == '?' || ch == '!' || ch == '/')) pool_flush();
 
         switch (ch) {
             case '?':
@@ -875,6 +969,16 @@ void commandloop(char *initscript) {
                 echoing = 0;
                 polyshowerror = 0; /* gets set by wrong use of $+, readvals */
                 commandmode = 1;
+                if (npool) { /* keep text of line for pool_eval() */
+                    FILE *lf;
+                    int n = rv_getline(stdin);
+                    if ((lf = fmemopen(rv_buf, n, "r")) != NULL) {
+                        poolline = rv_buf, s_in = lf;
+                        yyparse();
+                        poolline = NULL, s_in = stdin;
+                        fclose(lf);
+                    } else yyparse();
+                } else
                 yyparse();
                 if (SYNERR) SYNERR = 0;
                 else if (c != '\n') { /* APPARENTLY NEVER TRUE */
@@ -888,9 +992,285 @@ void commandloop(char *initscript) {
     }
 }
 
+/* mira -serve path [script] loads the script once and then listens on a
+   Unix domain socket at path.  Each connection carries one expression,
+   terminated by a newline, which is compiled and evaluated in a forked copy
+   of the server - so the loaded heap is shared copy-on-write and nothing the
+   evaluation does survives it - with all output going back down the
+   connection, followed by the statistics of the evaluation (as for /count,
+   with the elapsed time added).  The server never returns. */
+void serve(char *path, char *initscript) {
+    extern word cook_stdin;
+    struct sockaddr_un addr;
+    int sock, conn, ch;
+    if (setjmp(env) == 0) undump(initscript);
+    (void)signal(SIGINT, SIG_DFL);
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "mira: socket name too long \"%s\"\n", path);
+        exit(1);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    (void)unlink(path); /* left over from previous server */
+    if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ||
+        bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+        listen(sock, 64) == -1) {
+        perror("mira: -serve");
+        exit(1);
+    }
+    for (;;) {
+        while (waitpid(-1, NULL, WNOHANG) > 0); /* reap finished workers */
+        if ((conn = accept(sock, NULL, NULL)) == -1) {
+            if (errno == EINTR) continue;
+            perror("mira: accept");
+            exit(1);
+        }
+        if (rechecking && src_update()) loadfile(current_script);
+        switch (fork()) {
+            case -1:
+                perror("UNIX error - cannot create process");
+                close(conn);
+                continue;
+            case 0:
+                break;
+            default:
+                close(conn);
+                continue;
+        }
+        /* worker */
+        close(sock);
+        dup2(conn, 0), dup2(conn, 1), dup2(conn, 2), close(conn);
+        clearerr(stdin);
+        setvbuf(stdout, NULL, _IOFBF, BUFSIZ); /* not a tty, see main() */
+        serving = 1; /* tells process() not to fork again */
+        atcount = 1, resetstats();
+        while ((ch = getchar()) == ' ' || ch == '\t' || ch == '\n');
+        if (ch == EOF) exit(0);
+        ungetc(ch, stdin);
+        lastid = 0;
+        tl[hd[cook_stdin]] = 0; /* unset type of $+ */
+        rv_expr = 0;
+        c = EVAL;
+        echoing = 0;
+        polyshowerror = 0;
+        commandmode = 1;
+        yyparse();
+        exit(0);
+    }
+}
+
+/* Fast path for readvals and $+.  Data files mostly consist of literals -
+   numbers, chars, strings, lists, tuples and constructors applied to these -
+   and such values can be built directly, guided by the type recorded in the
+   STARTREADVALS cell, without a trip through yyparse, type_of and codegen for
+   each line.  A line the fast reader does not accept is handed to the
+   general parser unchanged, so the fast path alters no behaviour. */
+
+#define RV_FAIL (-1)
+static unsigned char *rv_p; /* read pointer into rv_buf */
+#define rv_skip() while (*rv_p == ' ' || *rv_p == '\t' || *rv_p == '\r') rv_p++
+
+static int rv_getline(FILE *f) { /* reads next line of f into rv_buf, returns its
+	length; a newline escaped inside a string literal does not end the line */
+    int n = 0, ch, prev = ' ', instr = 0, incomment = 0;
+    for (;;) {
+        if (n + 5 >= rv_size) {
+            rv_buf = realloc(rv_buf, rv_size += BUFSIZE);
+            if (rv_buf == NULL) {
+                fprintf(stderr, "panic: cannot allocate readvals line buffer\n");
+                exit(1);
+            }
+        }
+        if ((ch = getc(f)) == EOF || ch == '\n') break;
+        rv_buf[n++] = ch;
+        if (incomment) continue;
+        if (instr) {
+            if (ch == '"') instr = 0;
+            else if (ch == '\\' && (ch = getc(f)) != EOF) rv_buf[n++] = ch;
+            continue;
+        }
+        if (ch == '"') instr = 1;
+        else if (ch == '|' && prev == '|') incomment = 1;
+        else if (ch == '\'' && !okid(prev)) { /* char literal, may hold '"' */
+            if ((ch = getc(f)) == EOF || ch == '\n') break;
+            rv_buf[n++] = ch;
+            if (ch == '\\' && (ch = getc(f)) != EOF && ch != '\n') rv_buf[n++] = ch;
+            if (ch == EOF || ch == '\n') break;
+            ch = 'x'; /* so the closing quote is taken as a prime */
+        }
+        prev = ch;
+    }
+    rv_buf[n++] = '\n';
+    rv_buf[n] = '\0';
+    return n;
+}
+
+static int rv_char(void) { /* reads one literal character at rv_p, using the same
+	escape conventions as getlitch() in lex.c, returns -1 if not acceptable */
+    int ch = *rv_p++, i, n;
+    if (ch == '\n') return -1;
+    if (UTF8 && ch > 127) {
+        n = (ch & 0xe0) == 0xc0 ? 2 : (ch & 0xf0) == 0xe0 ? 3 : (ch & 0xf8) == 0xf0 ? 4 : 0;
+        if (n == 0) return -1;
+        for (ch &= 0x7f >> n, i = 1; i < n; i++) {
+            if ((*rv_p & 0xc0) != 0x80) return -1;
+            ch = ch << 6 | *rv_p++ & 0x3f;
+        }
+        return ch > UMAX ? -1 : ch;
+    }
+    if (ch != '\\') return ch;
+    switch (ch = *rv_p++) {
+        case 'a': return '\a';
+        case 'b': return '\b';
+        case 'f': return '\f';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case 'v': return '\v';
+        case '\\': case '\'': case '"': case '`': return ch;
+        case 'x': case 'X':
+            if (!isxdigit(*rv_p)) return -1;
+            for (n = ch == 'x' ? 4 : 6, ch = i = 0; i < n && isxdigit(*rv_p); i++, rv_p++)
+                ch = 16 * ch + (isdigit(*rv_p) ? *rv_p - '0' : tolower(*rv_p) - 'a' + 10);
+            return ch > UMAX ? -1 : ch;
+        default:
+            if (!isdigit(ch)) return -1;
+            for (ch -= '0', i = 1; i < 3 && isdigit(*rv_p); i++) ch = 10 * ch + *rv_p++ - '0';
+            return ch;
+    }
+}
+
+static int rv_resolve(word *t, word *env) { /* strips `!' and replaces a type variable
+	by its binding in env, a list of cons(tvar number,cons(type,env)) */
+    word e;
+    if (tag[*t] == AP && hd[*t] == strict_t) *t = tl[*t];
+    while (isvar_t(*t)) {
+        for (e = *env; e != NIL && hd[hd[e]] != gettvar(*t); e = tl[e]);
+        if (e == NIL) return 0;
+        *t = hd[tl[hd[e]]], *env = tl[tl[hd[e]]];
+    }
+    return 1;
+}
+
+static word rv_val(word t, word env, int atomic) { /* reads a value of type t at rv_p,
+	returns RV_FAIL if the text is not a literal of that type; if atomic is
+	set only forms that can be the argument of a constructor are accepted */
+    word x, r = NIL, *q = &r;
+    unsigned char *s;
+    int ch;
+    if (!rv_resolve(&t, &env)) return RV_FAIL;
+    rv_skip();
+    if (*rv_p == '(' && !iscomma_t(t)) {
+        rv_p++;
+        if ((x = rv_val(t, env, 0)) == RV_FAIL) return RV_FAIL;
+        rv_skip();
+        return *rv_p++ == ')' ? x : RV_FAIL;
+    }
+    if (t == num_t) {
+        int isdbl = 0, n;
+        s = rv_p;
+        if (*rv_p == '-' && !atomic) rv_p++;
+        if (!isdigit(*rv_p) || *rv_p == '0' && isalpha(rv_p[1])) return RV_FAIL;
+        while (isdigit(*rv_p)) rv_p++;
+        if (*rv_p == '.' && isdigit(rv_p[1]))
+            for (isdbl = 1, rv_p++; isdigit(*rv_p); rv_p++);
+        if (*rv_p == 'e') {
+            isdbl = 1, rv_p++;
+            if (*rv_p == '+' || *rv_p == '-') rv_p++;
+            if (!isdigit(*rv_p)) return RV_FAIL;
+            while (*rv_p == '0') rv_p++;
+            for (n = 0; isdigit(*rv_p); n++) rv_p++;
+            if (n > 3 || rv_p - s > 60) return RV_FAIL; /* let numeral() complain */
+        }
+        ch = *rv_p, *rv_p = '\0';
+        if (isdbl) {
+            double d = 0.0;
+            sscanf((char *)s, "%lf", &d);
+            x = sto_dbl(d);
+        } else x = bigscan((char *)s);
+        *rv_p = ch;
+        return x;
+    }
+    if (t == char_t) {
+        if (*rv_p++ != '\'' || (ch = rv_char()) < 0 || *rv_p++ != '\'') return RV_FAIL;
+        return sto_char(ch);
+    }
+    if (t == bool_t) {
+        if (strncmp((char *)rv_p, "True", 4) == 0 && !okid(rv_p[4])) return rv_p += 4, True;
+        if (strncmp((char *)rv_p, "False", 5) == 0 && !okid(rv_p[5])) return rv_p += 5, False;
+        return RV_FAIL;
+    }
+    if (islist_t(t)) {
+        word et = tl[t], eenv = env;
+        if (!rv_resolve(&et, &eenv)) return RV_FAIL;
+        if (et == char_t && *rv_p == '"') {
+            for (rv_p++; *rv_p != '"'; ) {
+                if (*rv_p == '\\' && (rv_p[1] == '&' || rv_p[1] == '\n')) {
+                    rv_p += 2; /* null escape, escaped newline */
+                    continue;
+                }
+                if ((ch = rv_char()) < 0) return RV_FAIL;
+                *q = cons(sto_char(ch), NIL), q = &tl[*q];
+            }
+            rv_p++;
+            return r;
+        }
+        if (*rv_p++ != '[') return RV_FAIL;
+        rv_skip();
+        if (*rv_p == ']') return rv_p++, NIL;
+        for (;;) {
+            if ((x = rv_val(et, eenv, 0)) == RV_FAIL) return RV_FAIL;
+            *q = cons(x, NIL), q = &tl[*q];
+            rv_skip();
+            if (*rv_p == ']') return rv_p++, r;
+            if (*rv_p++ != ',') return RV_FAIL;
+        }
+    }
+    if (iscomma_t(t)) { /* (a,b,c) is represented as cons(a,cons(b,c)) */
+        if (*rv_p++ != '(') return RV_FAIL;
+        for (;;) {
+            if ((x = rv_val(tl[hd[t]], env, 0)) == RV_FAIL) return RV_FAIL;
+            rv_skip();
+            if ((t = tl[t]) == void_t) {
+                *q = x;
+                return *rv_p++ == ')' ? r : RV_FAIL;
+            }
+            if (*rv_p++ != ',') return RV_FAIL;
+            *q = cons(x, NIL), q = &tl[*q];
+        }
+    }
+    { word tn, con, ct, rt, cenv = NIL;
+        for (tn = t; iscompound_t(tn); tn = hd[tn]);
+        if (tag[tn] != ID || id_type(tn) != type_t || t_class(tn) != algebraic_t)
+            return RV_FAIL; /* abstract and private types go the long way */
+        s = rv_p;
+        if (!isupper(*rv_p)) return RV_FAIL;
+        while (okid(*rv_p)) rv_p++;
+        for (con = t_info(tn); con != NIL; con = tl[con])
+            if (strlen(get_id(hd[con])) == rv_p - s &&
+                strncmp(get_id(hd[con]), (char *)s, rv_p - s) == 0) break;
+        if (con == NIL) return RV_FAIL;
+        ct = id_type(hd[con]);
+        if (atomic && isarrow_t(ct)) return RV_FAIL; /* needs parentheses */
+        for (rt = ct; isarrow_t(rt); rt = tl[rt]);
+        /* bind type variables of constructor to parameters of t */
+        for (x = t; iscompound_t(rt) && iscompound_t(x); rt = hd[rt], x = hd[x])
+            if (isvar_t(tl[rt])) cenv = cons(cons(gettvar(tl[rt]), cons(tl[x], env)), cenv);
+        for (x = hd[con]; isarrow_t(ct); ct = tl[ct]) {
+            word a = rv_val(tl[hd[ct]], cenv, 1);
+            if (a == RV_FAIL) return RV_FAIL;
+            x = ap(x, a);
+        }
+        return x;
+    }
+}
+
 word parseline(word t, FILE *f, word fil) { /* parses next valid line of f at type t, returns EOF
 		      if none found.  See READVALS in reduce.c */
     word t1, ch_val;
+    FILE *lf;
+    int n;
     lastexp = UNDEF;
     for (;;) {
         ch_val = getc(f);
@@ -905,12 +1285,23 @@ word parseline(word t, FILE *f, word fil) { /* parses next valid line of f at ty
         }
         if (ch_val == EOF) return (word)EOF;
         ungetc(ch_val, f);
+        n = rv_getline(f);
+        rv_p = (unsigned char *)rv_buf;
+        if ((t1 = rv_val(t, NIL, 0)) != RV_FAIL) {
+            rv_skip();
+            if (*rv_p == '\n' || rv_p[0] == '|' && rv_p[1] == '|') return t1;
+        }
+        if ((lf = fmemopen(rv_buf, n, "r")) == NULL) {
+            fprintf(stderr, "panic: cannot reread line of readvals data\n");
+            exit(1);
+        }
         c = VALUE;
         echoing = 0;
         commandmode = 1;
-        s_in = f;
+        s_in = lf;
         yyparse();
         s_in = stdin;
+        fclose(lf);
         if (SYNERR) SYNERR = 0, lastexp = UNDEF;
         else if ((t1 = type_of(lastexp)) == wrong_t) lastexp = UNDEF;
         else if (!subsumes(instantiate(t1), t)) {
@@ -948,6 +1339,18 @@ word fm_time(const char *f) { /* time last modified of file f */
     /* non-existent file has conventional mtime of 0 */
 } /* we assume time_t can be stored in a word */
 
+unsigned long long fm_hash(const char *f) { /* hash of contents of file f */
+    unsigned char b[BUFSIZ];
+    unsigned long long h = 14695981039346656037ULL; /* FNV-1a */
+    ssize_t n, i;
+    int in = open(f, O_RDONLY);
+    if (in == -1) return 0;
+    while ((n = read(in, b, sizeof(b))) > 0)
+        for (i = 0; i < n; i++) h = (h ^ b[i]) * 1099511628211ULL;
+    close(in);
+    return n < 0 ? 0 : h ? h : 1;
+} /* 0 means unreadable */
+
 #define same_file(x, y) (hd[fil_inodev(x)] == hd[fil_inodev(y)] && \
                          tl[fil_inodev(x)] == tl[fil_inodev(y)])
 #define inodev(f) (stat(f, &buf) == 0 ? datapair(buf.st_ino, buf.st_dev) : \
@@ -983,12 +1386,15 @@ void reset(void) { /* interrupt catcher - see call to signal in commandloop */
         if (unlinkme) unlink(unlinkme);
         /* stackp=dstack; /* add if undump() made interruptible later*/
         oldfiles = files, unload(), current_id = ATNAMES = loading = SYNERR = lineptr = 0;
+        tdepth = 0;
         if (blankerr) blankerr = 0, makedump();
     }
     /* magic script cannot be literate so no guard needed on makedump */
     else
         printf("<<interrupt>>\n"); /* VAX, SUN, ^C does not cause newline */
     reset_state(); /* see LEX */
+    sort_reset();
+    tw_stop();
     if (collecting) collecting = 0, gc(); /* to mark stdenv etc as wanted */
     if (making && !make_status) make_status = 1;
 #ifdef SYSTEM5
@@ -1059,12 +1465,13 @@ void command(void) {
         case 'd':
             if (is("dic")) {
                 extern char *dic;
+                extern word dicold;
                 if (!token()) {
                     lose = getchar(); /* to eat \n */
                     printf("%ld chars", DICSPACE);
                     if (DICSPACE != DFLTDICSPACE)
                         printf(" (default=%ld)", DFLTDICSPACE);
-                    printf(" %ld in use\n", (long)(dicq - dic));
+                    printf(" per block, %ld in use\n", (long)(dicq - dic + dicold));
                     return;
                 }
                 consume_eol();
@@ -1267,16 +1674,13 @@ void command(void) {
             }
             break;
         case 'n':
-            /* if(is("namebuckets"))
-               { int i,x;
-                 extern word namebucket[];
+            /* if(is("names"))
+               { int i;
+                 extern word *idtab,idtabsize;
                  consume_eol();
-                 for(i=0;i<128;i++)
-                 if(x=namebucket[i])
-                   { printf("%d:",i);
-                     while(x)
-                          putchar(' '),out(stdout,hd[x]),x=tl[x];
-                     putchar('\n'); }
+                 for(i=0;i<idtabsize;i++)
+                 if(idtab[i])
+                   printf("%d: ",i),out(stdout,idtab[i]),putchar('\n');
                  return; }              /* DEBUG */
             if (is("nocount")) {
                 consume_eol();
@@ -1306,9 +1710,41 @@ void command(void) {
                 rc_write();
                 return;
             }
+            if (is("nopartypes")) {
+                consume_eol();
+                partypes = 0;
+                return;
+            }
+            if (is("nopackrat")) {
+                consume_eol();
+                packrat = 0;
+                return;
+            }
+            if (is("notypecache")) {
+                consume_eol();
+                typecache = 0;
+                return;
+            }
+            if (is("notimings")) {
+                consume_eol();
+                attimings = 0;
+                return;
+            }
             break;
         /* case 'o': if(is("object"))
                        { consume_eol(); atobject=1; return; } /* now done by flag -object */
+        case 'p':
+            if (is("packrat")) {
+                consume_eol();
+                packrat = 1;
+                return;
+            }
+            if (is("partypes")) {
+                consume_eol();
+                partypes = 1;
+                return;
+            }
+            break;
         case 'q':
             if (is("q") || is("quit")) {
                 consume_eol();
@@ -1336,6 +1772,12 @@ void command(void) {
                     printf("\t-nostrictif (deprecated!)\n");
                 if (atcount) printf("\tcount\n");
                 if (atgc) printf("\tgc\n");
+                if (gcthreads > 1) printf("\tgcthreads %d\n", gcthreads);
+                if (packrat) printf("\tpackrat\n");
+                if (typecache) printf("\ttypecache\n");
+                if (partypes) printf("\tpartypes\n");
+                if (attimings) printf("\ttimings%s\n", attimings == 2 ? " json" : "");
+                if (nworkers) printf("\tworkers %d\n", nworkers);
                 if (UTF8) printf("\tUTF-8 i/o\n");
                 if (!verbosity) printf("\thush\n");
                 if (debug) printf("\tdebug 0%o\n", debug);
@@ -1343,6 +1785,47 @@ void command(void) {
                 return;
             }
             break;
+        case 't':
+            if (is("timings")) {
+                int json;
+                if (!token()) {
+                    lose = getchar(); /* to eat \n */
+                    attimings = 1;
+                    return;
+                }
+                json = strcmp(dicp, "json") == 0;
+                consume_eol();
+                if (!json) {
+                    printf("\7unknown option \"%s\" (only json allowed)\n", dicp);
+                    return;
+                }
+                attimings = 2;
+                return;
+            }
+            if (is("typecache")) {
+                consume_eol();
+                typecache = 1;
+                return;
+            }
+            break;
+        case 'w':
+            if (is("workers")) {
+                int n;
+                if (!token()) {
+                    lose = getchar(); /* to eat \n */
+                    printf("%d pre-forked evaluation process%s\n", nworkers,
+                           nworkers == 1 ? "" : "es");
+                    return;
+                }
+                consume_eol();
+                if (sscanf(dicp, "%d", &n) != 1 || n < 0 || n > MAXWORKERS) {
+                    printf("illegal value (must be 0..%d)\n", MAXWORKERS);
+                    return;
+                }
+                nworkers = n; /* pool refilled at next prompt */
+                return;
+            }
+            break;
         case 'v':
             if (is("v") || is("version")) {
                 consume_eol();
@@ -1640,6 +2123,46 @@ word bereaved; /* typenames referred to in exports and not exported */
 word ld_stuff = NIL;
 /* list of list of files, to be unloaded if mkincludes interrupted */
 
+void tnow(struct tstamp *s) { /* reading of clocks and heap counters */
+    extern long claims, nogcs;
+    extern long long cellcount;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    s->wall = ts.tv_sec + ts.tv_nsec / 1e9;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    s->cpu = ts.tv_sec + ts.tv_nsec / 1e9;
+    s->cells = cellcount + claims;
+    s->gcs = nogcs;
+}
+
+void tstart(void) { /* start timing a phase of compilation, see tstop() */
+    if (!attimings) return;
+    if (tdepth < TDEPTH) tnow(&tstack[tdepth]);
+    tdepth++;
+}
+
+void tstop(const char *phase, const char *f) { /* report phase begun at last tstart() */
+    struct tstamp now, *s;
+    if (!attimings || tdepth == 0) return;
+    if (--tdepth >= TDEPTH) return;
+    tnow(&now);
+    s = &tstack[tdepth];
+    if (!f) f = current_script ? current_script : "";
+    if (attimings == 2) {
+        printf("{\"phase\": \"%s\", \"file\": \"", phase);
+        for (; *f; f++) {
+            if (*f == '"' || *f == '\\') putchar('\\');
+            if ((unsigned char)*f < ' ') printf("\\u%04x", *f);
+            else putchar(*f);
+        }
+        printf("\", \"depth\": %d, \"wall\": %.6f, \"cpu\": %.6f, \"cells\": %lld, \"gcs\": %ld}\n",
+               tdepth, now.wall - s->wall, now.cpu - s->cpu, now.cells - s->cells, now.gcs - s->gcs);
+    } else
+        printf("||%*s%s %s: wall = %0.3f, cpu = %0.3f, cells claimed = %lld, no of gc's = %ld\n",
+               2 * tdepth, "", phase, f, now.wall - s->wall, now.cpu - s->cpu,
+               now.cells - s->cells, now.gcs - s->gcs);
+} /* nested phases are reported first, indented */
+
 void loadfile(char *t) {
     extern word fileq;
     extern word current_id, includees, embargoes, exportfiles, freeids, exports;
@@ -1675,6 +2198,7 @@ void loadfile(char *t) {
         loading = 0;
         return;
     }
+    tstart(); /* compile */
     files = cons(make_fil(t, fm_time(t), 1, NIL), NIL);
     current_file = hd[files];
     tl[hd[fileq]] = current_file;
@@ -1693,7 +2217,9 @@ void loadfile(char *t) {
     nextpn = 0; /* lose pnames */
     embargoes = detrop =
     fnts = rfl = bereaved = ld_stuff = exportfiles = freeids = exports = includees = FBS = NIL;
+    tstart();
     yyparse();
+    tstop("parse", t);
 
     if (!SYNERR && exportfiles != NIL) {
         /* check pathnames in exportfiles have unique bindings */
@@ -1723,7 +2249,9 @@ void loadfile(char *t) {
     }
 
     if (!SYNERR && includees != NIL) {
+        tstart();
         files = append1(files, mkincludes(includees));
+        tstop("includes", t);
         includees = NIL;
     }
     ld_stuff = NIL;
@@ -1731,7 +2259,9 @@ void loadfile(char *t) {
     if (!SYNERR) {
         if (verbosity || (making && !mkexports && !mksources))
             printf("checking types in %s\n", t);
+        tstart();
         checktypes();
+        tstop("checktypes", t);
         /* printf("typecheck complete\n"); /* DEBUG */
     }
 
@@ -1845,6 +2375,7 @@ void loadfile(char *t) {
         extern int lfrule;
         /* we invoke the code generator */
         lfrule = 0;
+        tstart();
         for (x_item = fil_defs(hd[files]); x_item != NIL; x_item = tl[x_item])
             if (id_type(hd[x_item]) != type_t) {
                 current_id = hd[x_item];
@@ -1855,21 +2386,25 @@ void loadfile(char *t) {
                    namely polymorphic show or readvals */
             }
         current_id = 0;
+        tstop("codegen", t);
         if (lfrule && (verbosity || making))
             printf("grammar optimisation: %d common left factors found\n", lfrule);
         if (initialising && ND != NIL) {
             fprintf(stderr, "panic: %s contains errors\n", okprel ? "stdenv" : "prelude");
             exit(1);
         }
+        tstart();
         if (initialising) makedump();
         else if (normal(t)) /* file ends ".m", formerly if(!magic) */
             fixexports(), makedump(), unfixexports();
+        tstop("makedump", t);
         /* changed 26.11.2019 to allow dump of magic scripts ending ".m" */
         if (!errline && errs && (char *)hd[errs] == current_script)
             errline = tl[errs]; /* soft error (posn not saved in dump) */
         ND = alfasort(ND);
         /* we could sort and remove pnames from each defs component immediately
            after makedump(), instead of doing this in namescom */
+        tstop("compile", t);
         loading = 0;
         return;
     }
@@ -1882,6 +2417,7 @@ void loadfile(char *t) {
     unload();
     if (normal(t) && SYNERR != 2) makedump(); /* make syntax error dump */
     /* allow dump of magic script in ".m", was if(!magic&&) 26.11.2019 */
+    tstop("compile", t);
     SYNERR = 0;
     loading = 0;
 }
@@ -1932,8 +2468,8 @@ void unfixexports(void) {
 } /* may not be interrupt safe, re unload() */
 
 word privatise(word x) { /* change id to pname, and return new id holding it as value */
-    extern word namebucket[], *pnvec;
-    word n = make_pn(x), h = namebucket[hash(get_id(x))], i;
+    extern word *pnvec;
+    word n = make_pn(x), i;
     if (id_type(x) == type_t)
         t_info(x) = cons(datapair(getaka(x), 0), get_here(x));
     /* to assist identification of danging type refs - see typesharing code
@@ -1944,26 +2480,23 @@ word privatise(word x) { /* change id to pname, and return new id holding it as
         /* this will generate sensible error message on attempt to use value
            see reduction rule for DATAPAIR */
     }
+    idreplace(x, n);
     pnvec[i = hd[n]] = x;
     tag[n] = ID;
     hd[n] = hd[x];
     tag[x] = STRCONS;
     hd[x] = i;
-    while (hd[h] != x) h = tl[h];
-    hd[h] = n;
     return n;
 } /* WARNING - dependent on internal representation of ids and pnames */
 /* nasty problem - privatisation can screw AKA's */
 
 word publicise(word x) { /* converse of the above, applied to the new id */
-    extern word namebucket[];
-    word i = id_val(x), h = namebucket[hash(get_id(x))];
+    word i = id_val(x);
     tag[i] = ID, hd[i] = hd[x];
     /* WARNING - USES FACT THAT tl HOLDS VALUE FOR BOTH ID AND PNAME */
     if (tag[tl[i]] == AP && tag[hd[tl[i]]] == DATAPAIR)
         tl[i] = UNDEF; /* undo kludge, see above */
-    while (hd[h] != x) h = tl[h];
-    hd[h] = i;
+    idreplace(x, i);
     return i;
 }
 
@@ -2031,7 +2564,9 @@ word mkincludes(word includees_list) {
         if (!making) /* cannot interrupt load_script() */
             oldsig = signal(SIGINT, (sighandler)sigdefer);
         if ((f = fopen(dicp, "r"))) {
+            tstart();
             x = load_script(f, fn, hd[tl[hd[includees_list]]], tl[tl[hd[includees_list]]], 0);
+            tstop("load", fn);
             (void)fclose(f);
         }
         ld_stuff = cons(x, ld_stuff);
@@ -2180,6 +2715,150 @@ word mkincludes(word includees_list) {
     return result;
 }
 
+/* mira -make -j N.  The %include graph of the scripts named is found by
+   scanning their sources, then each script is brought up to date by a
+   process of its own as soon as all its includees have been, with at most
+   N such processes at once.  This leaves current dumps for the ordinary
+   -make loop, which reports errors as before.  A dependency the scan
+   misses (eg a pathname beginning "~") costs only parallelism, since
+   mkincludes() then compiles it in the usual way - makedump() replaces a
+   dump by renaming, so two processes compiling the same script is safe. */
+
+static struct mkjob {
+    char *src;
+    dev_t dev;
+    ino_t ino;
+    int *deps, ndeps; /* includees, as indices in mkjobs */
+    int left; /* includees not yet up to date */
+    pid_t pid; /* 0 = waiting, -1 = done */
+    FILE *log; /* output of the process */
+} *mkjobs = NULL;
+static int nmkjobs = 0;
+
+static int mkscan(const char *src) { /* index of job for src, -1 if none */
+    struct stat st;
+    int i;
+    if (stat(src, &st) == -1) return -1;
+    for (i = 0; i < nmkjobs; i++)
+        if (mkjobs[i].dev == st.st_dev && mkjobs[i].ino == st.st_ino) return i;
+    if ((nmkjobs & 63) == 0 &&
+        !(mkjobs = realloc(mkjobs, (nmkjobs + 64) * sizeof(struct mkjob))))
+        mallocfail("make graph");
+    i = nmkjobs++;
+    mkjobs[i].src = strdup(src);
+    mkjobs[i].dev = st.st_dev, mkjobs[i].ino = st.st_ino;
+    mkjobs[i].deps = NULL, mkjobs[i].ndeps = mkjobs[i].left = 0;
+    mkjobs[i].pid = 0, mkjobs[i].log = NULL;
+    if (!mkjobs[i].src) mallocfail("make graph");
+    mkscanfile(i, src, 0);
+    return i;
+}
+
+static int scandirective(const char *f, char *line, int lit, char *path) {
+    /* 1 if line of script f is an %include directive, 2 if an %insert, else
+       0 - and the pathname it names, or "" if that is not found so easily */
+    char *p = line, *q, *d;
+    int incl;
+    size_t n;
+    *path = '\0';
+    if (lit && *p++ != '>') return 0; /* literate comment */
+    while (*p == ' ' || *p == '\t') p++;
+    if (strncmp(p, "%include", 8) == 0) incl = 1, p += 8;
+    else if (strncmp(p, "%insert", 7) == 0) incl = 2, p += 7;
+    else return 0;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '<' && (q = strchr(p + 1, '>')))
+        n = snprintf(path, pnlim, "%s/%.*s", miralib, (int)(q - p - 1), p + 1);
+    else if (*p == '\"' && p[1] != '~' && (q = strchr(p + 1, '\"'))) {
+        d = p[1] == '/' ? NULL : strrchr(f, '/');
+        n = snprintf(path, pnlim, "%.*s%.*s", d ? (int)(d - f + 1) : 0, f,
+                     (int)(q - p - 1), p + 1);
+    } else return incl;
+    if (n + 3 >= pnlim) {
+        *path = '\0';
+        return incl;
+    }
+    if (incl == 1 && (n < 2 || strcmp(path + n - 2, ".m"))) { /* as addextn() */
+        if (n >= 2 && strcmp(path + n - 2, ".x") == 0) n -= 2;
+        else if (n && path[n - 1] == '.') n--;
+        (void)strcpy(path + n, ".m");
+    }
+    return incl;
+}
+
+static int litscript(const char *f, FILE *in) { /* is f a literate script? */
+    extern int litname(char *);
+    int lit = litname((char *)f) || getc(in) == '>';
+    rewind(in);
+    return lit;
+}
+
+static void mkscanfile(int i, const char *f, int depth) {
+    /* add the %include directives of file f to job i, following %insert */
+    char line[BUFSIZE], path[pnlim];
+    FILE *in = fopen(f, "r");
+    int lit, k, d;
+    size_t n;
+    if (!in) return;
+    lit = litscript(f, in);
+    while (fgets(line, sizeof(line), in)) {
+        if (!(d = scandirective(f, line, lit, path)) || !*path) continue;
+        if (d == 2) {
+            if (depth < 12) mkscanfile(i, path, depth + 1);
+            continue;
+        }
+        if ((k = mkscan(path)) < 0 || k == i) continue;
+        for (n = 0; n < (size_t)mkjobs[i].ndeps && mkjobs[i].deps[n] != k; n++);
+        if (n < (size_t)mkjobs[i].ndeps) continue;
+        if (!(mkjobs[i].deps = realloc(mkjobs[i].deps, (n + 1) * sizeof(int))))
+            mallocfail("make graph");
+        mkjobs[i].deps[mkjobs[i].ndeps++] = k;
+        mkjobs[i].left++;
+    }
+    fclose(in);
+}
+
+static void mkparallel(int nargs, char **args) {
+    char buf[BUFSIZ];
+    int i, k, n, running = 0;
+    pid_t pid;
+    for (i = 0; i < nargs; i++) (void)mkscan(addextn(1, args[i]));
+    for (;;) {
+        for (i = 0; i < nmkjobs && running < makejobs; i++) {
+            if (mkjobs[i].pid != 0 || mkjobs[i].left != 0) continue;
+            fflush(stdout);
+            mkjobs[i].log = tmpfile(); /* its messages, printed when it ends */
+            if ((pid = fork()) == -1) { /* the -make loop does the rest */
+                if (mkjobs[i].log) fclose(mkjobs[i].log);
+                break;
+            }
+            if (pid == 0) { /* child brings this script up to date */
+                ideep = 1;
+                echoing = listing = verbosity = 0;
+                if (mkjobs[i].log) dup2(fileno(mkjobs[i].log), 1);
+                if (setjmp(env) == 0) undump(mkjobs[i].src);
+                exit(0);
+            }
+            mkjobs[i].pid = pid, running++;
+        }
+        if (running == 0) break; /* finished, or cyclic %include */
+        while ((pid = wait(NULL)) == -1 && errno == EINTR);
+        if (pid == -1) break;
+        for (i = 0; i < nmkjobs && mkjobs[i].pid != pid; i++);
+        if (i == nmkjobs) continue;
+        mkjobs[i].pid = -1, running--;
+        if (mkjobs[i].log) {
+            rewind(mkjobs[i].log);
+            while ((n = fread(buf, 1, sizeof(buf), mkjobs[i].log)) > 0)
+                (void)fwrite(buf, 1, n, stdout);
+            fclose(mkjobs[i].log);
+        }
+        for (k = 0; k < nmkjobs; k++)
+            for (n = 0; n < mkjobs[k].ndeps; n++)
+                if (mkjobs[k].deps[n] == i) mkjobs[k].left--;
+    }
+}
+
 word tlost = NIL;
 word pfrts = NIL; /* list of private free types bound in this script */
 
@@ -2274,7 +2953,7 @@ void unsetids(word d) { /* d is a list of identifiers */
                               id_who(hd[d]) = NIL,
                               id_type(hd[d]) = undef_t;
         d = tl[d];
-    } /* should we remove from namebucket ? */
+    } /* should we remove from idtab ? */
 }
 
 void unload(void) { /* clear out current script in preparation for reloading */
@@ -2387,6 +3066,7 @@ void dieclean(void) { /* called if evaluation is interrupted - see rules.y */
 word process(void) {
     pid_t pid;
     sighandler oldsig;
+    if (serving) return 1; /* a worker of serve() is already a process of its own */
     oldsig = signal(SIGINT, SIG_IGN);
     /* do not let parent receive interrupts intended for child */
     if ((pid = fork()) == -1) {
@@ -2399,28 +3079,374 @@ word process(void) {
     } else {
         int status; /* see man 2 exit, wait, signal */
         while (pid != wait(&status));
-        /* low byte of status is termination state of child, next byte is the
-           (low order byte of the) exit status */
-        if (WIFSIGNALED(status)) { /* abnormal termination status */
-            const char *cd = (status & 0200) ? " (core dumped)" : "";
-            const char *pc = ""; /* "probably caused by stack overflow\n";*/
-            switch (WTERMSIG(status)) {
-                case SIGBUS:
-                    printf("\n<<...bus error%s>>\n%s", cd, pc);
-                    break;
-                case SIGSEGV:
-                    printf("\n<<...segmentation fault%s>>\n%s", cd, pc);
-                    break;
-                default:
-                    printf("\n<<...uncaught signal %d>>\n", WTERMSIG(status));
-            }
-        }
-        /*if(status >>= 8)printf("\n(exit status %d)\n",status); */
+        childstatus(status);
         (void)signal(SIGINT, oldsig); /* restore interrupt status */
         return 0;
     }
 }
 
+static void childstatus(int status) { /* report abnormal end of an evaluation process */
+    /* low byte of status is termination state of child, next byte is the
+       (low order byte of the) exit status */
+    if (WIFSIGNALED(status)) { /* abnormal termination status */
+        const char *cd = (status & 0200) ? " (core dumped)" : "";
+        const char *pc = ""; /* "probably caused by stack overflow\n";*/
+        switch (WTERMSIG(status)) {
+            case SIGBUS:
+                printf("\n<<...bus error%s>>\n%s", cd, pc);
+                break;
+            case SIGSEGV:
+                printf("\n<<...segmentation fault%s>>\n%s", cd, pc);
+                break;
+            default:
+                printf("\n<<...uncaught signal %d>>\n", WTERMSIG(status));
+        }
+    }
+    /*if(status >>= 8)printf("\n(exit status %d)\n",status); */
+}
+
+/* The pool of pre-forked evaluation processes, see /workers.  A worker is a
+   copy of mira forked at the prompt, after the current script was loaded,
+   which write-faults the heap pages an evaluation allocates into first and
+   then blocks reading a command line from its pipe.  When an expression has
+   been typechecked by the parent, evaluate() (see rules.y) sends its text to
+   a worker, which compiles it again in its own copy of the heap and
+   evaluates it just as the child of process() would; the parent waits for
+   it and forks a replacement.  The pool is emptied whenever a command other
+   than an expression is obeyed, as the workers no longer reflect the state
+   of the session, and is not used for expressions mentioning $$, $+, $- or
+   $*, which depend on state outside the heap copied at fork time. */
+
+
+static void pretouch(void) {
+    extern word listp;
+    volatile char stack[65536];
+    word i, top = listp + PRETOUCH;
+    if (top > SPACELIMIT + ATOMLIMIT) top = SPACELIMIT + ATOMLIMIT;
+    for (i = listp + 1; i < top; i += 512)
+        ((volatile word *)hd)[i] = hd[i], ((volatile word *)tl)[i] = tl[i];
+    for (i = listp + 1; i < top; i += 4096) ((volatile char *)tag)[i] = tag[i];
+    for (i = 0; i < sizeof(stack); i += 4096) stack[i] = 0;
+}
+
+static void pool_worker(int fd) { /* body of a worker - does not return */
+    extern word cook_stdin;
+    FILE *in, *lf;
+    int i, n;
+    for (i = 0; i < npool; i++) close(pool[i].fd); /* parent's ends */
+    npool = 0;
+    (void)signal(SIGINT, SIG_IGN); /* ^C at the prompt is not for us */
+    pretouch();
+    if ((in = fdopen(fd, "r")) == NULL || (i = getc(in)) == EOF) exit(0);
+    ungetc(i, in);
+    n = rv_getline(in);
+    if ((lf = fmemopen(rv_buf, n, "r")) == NULL) exit(1);
+    serving = 1; /* tells process() not to fork again */
+    s_in = lf;
+    lastid = 0;
+    tl[hd[cook_stdin]] = 0;
+    rv_expr = 0;
+    c = EVAL;
+    echoing = 0;
+    polyshowerror = 0;
+    commandmode = 1;
+    yyparse();
+    exit(0);
+}
+
+static void pool_fill(void) {
+    int fds[2];
+    pid_t pid;
+    while (npool < nworkers) {
+        if (pipe(fds) == -1) return;
+        if ((pid = fork()) == -1) {
+            close(fds[0]), close(fds[1]);
+            return;
+        }
+        if (pid == 0) close(fds[1]), pool_worker(fds[0]);
+        close(fds[0]);
+        pool[npool].pid = pid, pool[npool++].fd = fds[1];
+    }
+}
+
+static void pool_flush(void) {
+    while (npool > 0) {
+        npool--;
+        close(pool[npool].fd); /* worker sees EOF and exits */
+        while (waitpid(pool[npool].pid, NULL, 0) == -1 && errno == EINTR);
+    }
+}
+
+word pool_eval(void) { /* hand current expression to a worker, returns 0 if not possible */
+    sighandler oldsig;
+    int status = 0, n, i, fd;
+    pid_t pid, r;
+    if (npool == 0 || poolline == NULL || strchr(poolline, '$')) return 0;
+    pid = pool[0].pid, fd = pool[0].fd; /* oldest, most likely to be ready */
+    for (i = 1; i < npool; i++) pool[i - 1] = pool[i];
+    npool--;
+    n = strlen(poolline);
+    oldsig = signal(SIGINT, SIG_IGN);
+    if (write(fd, poolline, n) != n) {
+        close(fd);
+        kill(pid, SIGKILL);
+        while (waitpid(pid, NULL, 0) == -1 && errno == EINTR);
+        (void)signal(SIGINT, oldsig);
+        return 0;
+    }
+    close(fd);
+    while ((r = waitpid(pid, &status, 0)) == -1 && errno == EINTR);
+    if (r == pid) childstatus(status);
+    (void)signal(SIGINT, oldsig);
+    return 1; /* the pool is replenished at the next prompt */
+}
+
+/* The heap image written by mira -snapshot holds the state reached at
+   startup after the prelude and stdenv have been undumped, so that later
+   sessions can restore it in one piece instead of calling undump() twice.
+   mira_setup() is rerun as usual, as it is cheap and the cells it makes
+   contain addresses inside mira itself, and the image records the cells made
+   after that point together with any older cells since changed.  The rest of
+   the state is the dictionary, the name table, the private names and a few
+   words recorded in struct imghdr.  Strings in the heap are pointers into the
+   dictionary and are relocated when it has moved, which requires that it has
+   not grown past its first block (see dic_check() in lex.c).  The image is specific to
+   this machine and version of mira and is ignored, and the usual startup
+   followed, if it does not match, or if the prelude or stdenv, any file they
+   %include, or the .x file of one of these, has been modified since it was
+   written - the names of the files are kept at the end of the image. */
+
+#define IMGMAGIC "MIRAIMG"
+struct imghdr {
+    char magic[8];
+    word xversion, version, wordsize, atomlimit;
+    word listp0, dic0; /* state after mira_setup(), must match */
+    word mtime[4]; /* of prelude, preludx, stdenv.m, stdenv.x */
+    word listp, dicp, dicq, olddic, space, claims, nextpn, npatch;
+    word primenv, algshfns, nd, inprelude, idtabsize, nids;
+    word nincl, incllen; /* files loaded, and the length of their names */
+};
+
+static word img_listp0, img_dic0; /* see imgmark() */
+static word *img_hd, *img_tl;
+static char *img_tag, *img_dic, *img_dicbase;
+static char *img_incl = NULL; /* names of the files loaded, see imgfiles() */
+static word img_nincl = 0, img_incllen = 0;
+
+static void imgtimes(word *t) {
+    char obf[pnlim + 10];
+    t[0] = fm_time(PRELUDE);
+    (void)strcpy(obf, PRELUDE);
+    obf[strlen(obf) - 1] = 'x';
+    t[1] = fm_time(obf);
+    t[2] = fm_time(STDENV);
+    (void)strcpy(obf, STDENV);
+    obf[strlen(obf) - 1] = 'x';
+    t[3] = fm_time(obf);
+}
+
+static void imgfiles(void) { /* notes the names of the files just loaded, with
+    those they %include, for imgsave() */
+    word f, n;
+    for (f = files; f != NIL; f = tl[f]) {
+        n = strlen(get_fil(hd[f])) + 1;
+        img_incl = realloc(img_incl, img_incllen + n);
+        if (img_incl == NULL) mallocfail("heap image");
+        strcpy(img_incl + img_incllen, get_fil(hd[f]));
+        img_nincl++, img_incllen += n;
+    }
+}
+
+static void imginclt(char *s, word *t) { /* times of the file s and its .x */
+    char obf[pnlim + 10];
+    t[0] = fm_time(s);
+    (void)strcpy(obf, s);
+    obf[strlen(obf) - 1] = 'x';
+    t[1] = fm_time(obf);
+}
+
+static int imgincl(struct imghdr *h, char *p) { /* 0 if a file noted at p by
+    imgsave() has changed */
+    word i, t[2], u[2];
+    char *s = p + 2 * h->nincl * sizeof(word);
+    if (s[h->incllen - 1] != '\0') return 0;
+    for (i = 0; i < h->nincl; i++, s += strlen(s) + 1) {
+        if (s >= p + 2 * h->nincl * sizeof(word) + h->incllen) return 0;
+        memcpy(t, p + 2 * i * sizeof(word), sizeof(t));
+        imginclt(s, u);
+        if (memcmp(t, u, sizeof(t))) return 0;
+    }
+    return 1;
+}
+
+static int imgreloc(word i, word olddic, word dicused) { /* 0 if hd[i] is a string we cannot relocate */
+    extern char *dic;
+    word x;
+    if (tag[i] != STRCONS && tag[i] != DATAPAIR && tag[i] != FILEINFO) return 1;
+    x = hd[i];
+    if (olddic <= x && x < olddic + dicused) hd[i] = x - olddic + (word)dic;
+    else if (x < 0 || x > SPACELIMIT + ATOMLIMIT) return 0;
+    return 1;
+}
+
+static void imgmark(void) { /* called after mira_setup(), records state for imgsave() */
+    extern word listp;
+    extern char *dic;
+    word n;
+    img_listp0 = listp;
+    img_dic0 = dicp - dic;
+    img_dicbase = dic;
+    n = listp - ATOMLIMIT + 1;
+    img_hd = (word *)malloc(n * sizeof(word));
+    img_tl = (word *)malloc(n * sizeof(word));
+    img_tag = malloc(n);
+    img_dic = malloc(img_dic0);
+    if (img_hd == NULL || img_tl == NULL || img_tag == NULL || img_dic == NULL)
+        mallocfail("heap image");
+    memcpy(img_hd, hd + ATOMLIMIT, n * sizeof(word));
+    memcpy(img_tl, tl + ATOMLIMIT, n * sizeof(word));
+    memcpy(img_tag, tag + ATOMLIMIT, n);
+    memcpy(img_dic, dic, img_dic0);
+}
+
+static void imgsave(char *img) {
+    extern word SPACE, listp, *idtab, idtabsize, nids, *pnvec, nextpn, algshfns;
+    extern long claims;
+    extern int inprelude;
+    extern char *dic;
+    struct imghdr h;
+    word i, n, p[4];
+    char *m;
+    FILE *f;
+    if (dic != img_dicbase) {
+        fprintf(stderr, "mira: cannot make heap image, dictionary too small (see -dic)\n");
+        exit(1);
+    }
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, IMGMAGIC, sizeof(h.magic));
+    h.xversion = XVERSION, h.version = version;
+    h.wordsize = sizeof(word), h.atomlimit = ATOMLIMIT;
+    h.listp0 = img_listp0, h.dic0 = img_dic0;
+    imgtimes(h.mtime);
+    h.listp = listp, h.dicp = dicp - dic, h.dicq = dicq - dic, h.olddic = (word)dic;
+    h.space = SPACE, h.claims = claims, h.nextpn = nextpn;
+    h.primenv = primenv, h.algshfns = algshfns, h.nd = ND, h.inprelude = inprelude;
+    h.idtabsize = idtabsize, h.nids = nids;
+    h.nincl = img_nincl, h.incllen = img_incllen;
+    for (i = ATOMLIMIT; i <= listp; i++) {
+        n = i - ATOMLIMIT;
+        if (i <= img_listp0 && hd[i] == img_hd[n] && tl[i] == img_tl[n] &&
+            tag[i] == img_tag[n]) continue;
+        if (!imgreloc(i, h.olddic, h.dicp)) {
+            fprintf(stderr, "mira: cannot make heap image (cell %ld)\n", (long)i);
+            exit(1);
+        }
+        if (i <= img_listp0) h.npatch++;
+    }
+    if (!(f = fopen(img, "w"))) {
+        fprintf(stderr, "mira: cannot write to %s\n", img);
+        exit(1);
+    }
+    fwrite(&h, sizeof(h), 1, f);
+    fwrite(idtab, sizeof(word), idtabsize, f);
+    fwrite(pnvec, sizeof(word), nextpn, f);
+    for (i = ATOMLIMIT; i <= img_listp0; i++) {
+        n = i - ATOMLIMIT;
+        if (hd[i] == img_hd[n] && tl[i] == img_tl[n] && tag[i] == img_tag[n]) continue;
+        p[0] = i, p[1] = hd[i], p[2] = tl[i], p[3] = tag[i];
+        fwrite(p, sizeof(word), 4, f);
+    }
+    n = listp - img_listp0;
+    fwrite(hd + img_listp0 + 1, sizeof(word), n, f);
+    fwrite(tl + img_listp0 + 1, sizeof(word), n, f);
+    fwrite(tag + img_listp0 + 1, 1, n, f);
+    fwrite(img_dic, 1, img_dic0, f);
+    fwrite(dic, 1, h.dicp, f);
+    for (i = 0, m = img_incl; i < img_nincl; i++, m += strlen(m) + 1)
+        imginclt(m, p), fwrite(p, sizeof(word), 2, f);
+    fwrite(img_incl, 1, img_incllen, f);
+    if (fclose(f) == EOF) {
+        unlink(img);
+        fprintf(stderr, "mira: cannot write to %s\n", img);
+        exit(1);
+    }
+    printf("heap image %s written (%ld cells)\n", img, (long)(listp - ATOMLIMIT + 1));
+}
+
+static int imgload(char *img) { /* returns 0 if no valid heap image */
+    extern word SPACE, listp, *idtab, idtabsize, nids, *pnvec, nextpn, pn_lim, algshfns, newtyps;
+    extern long claims;
+    extern int inprelude;
+    extern char *dic;
+    struct imghdr h;
+    struct stat buf;
+    word t[4], n, i, *w;
+    char *m, *q;
+    int fd;
+    if ((fd = open(img, O_RDONLY)) == -1) return 0;
+    if (fstat(fd, &buf) == -1 || buf.st_size < sizeof(h) ||
+        (m = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+        close(fd);
+        return 0;
+    }
+    close(fd);
+    memcpy(&h, m, sizeof(h));
+    imgtimes(t);
+    n = h.listp - h.listp0;
+    if (memcmp(h.magic, IMGMAGIC, sizeof(h.magic)) || h.xversion != XVERSION ||
+        h.version != version || h.wordsize != sizeof(word) || h.atomlimit != ATOMLIMIT ||
+        h.listp0 != listp || h.dic0 != dicp - dic || memcmp(h.mtime, t, sizeof(t)) ||
+        h.listp >= SPACELIMIT + ATOMLIMIT || h.dicp >= DICSPACE ||
+        h.idtabsize < 2 * h.nids || (h.idtabsize & (h.idtabsize - 1)) ||
+        h.nincl < 0 || h.incllen < 1 ||
+        buf.st_size != sizeof(h) + (h.idtabsize + h.nextpn + 4 * h.npatch + 2 * n) * sizeof(word) +
+                       n + h.dic0 + h.dicp + 2 * h.nincl * sizeof(word) + h.incllen ||
+        memcmp(m + sizeof(h) + (h.idtabsize + h.nextpn + 4 * h.npatch + 2 * n) * sizeof(word) + n,
+               dic, h.dic0) ||
+        !imgincl(&h, m + buf.st_size - 2 * h.nincl * sizeof(word) - h.incllen)) {
+        munmap(m, buf.st_size);
+        return 0;
+    }
+    w = (word *)(m + sizeof(h));
+    if (h.idtabsize != idtabsize) {
+        free(idtab);
+        idtab = (word *)malloc(h.idtabsize * sizeof(word));
+        if (idtab == NULL) mallocfail("name table");
+        idtabsize = h.idtabsize;
+    }
+    memcpy(idtab, w, idtabsize * sizeof(word)), w += idtabsize;
+    nids = h.nids;
+    if (h.nextpn > pn_lim) {
+        pnvec = (word *)realloc(pnvec, (pn_lim = h.nextpn + 400) * sizeof(word));
+        if (pnvec == NULL) mallocfail("pnvec");
+    }
+    memcpy(pnvec, w, h.nextpn * sizeof(word)), w += h.nextpn;
+    nextpn = h.nextpn;
+    for (i = 0; i < h.npatch; i++, w += 4)
+        hd[w[0]] = w[1], tl[w[0]] = w[2], tag[w[0]] = w[3];
+    memcpy(hd + h.listp0 + 1, w, n * sizeof(word)), w += n;
+    memcpy(tl + h.listp0 + 1, w, n * sizeof(word)), w += n;
+    q = (char *)w;
+    memcpy(tag + h.listp0 + 1, q, n), q += n + h.dic0;
+    memcpy(dic, q, h.dicp);
+    if (h.olddic != (word)dic) { /* relocate strings */
+        for (w = (word *)(m + sizeof(h)) + h.idtabsize + h.nextpn, i = 0; i < h.npatch; i++, w += 4)
+            (void)imgreloc(w[0], h.olddic, h.dicp);
+        for (i = h.listp0 + 1; i <= h.listp; i++) (void)imgreloc(i, h.olddic, h.dicp);
+    }
+    munmap(m, buf.st_size);
+    listp = h.listp;
+    if (SPACE < h.space) SPACE = h.space;
+    if (SPACE > SPACELIMIT) SPACE = SPACELIMIT;
+    claims = h.claims;
+    dicp = dic + h.dicp, dicq = dic + h.dicq;
+    primenv = h.primenv, algshfns = h.algshfns, ND = h.nd;
+    inprelude = h.inprelude;
+    okprel = 1;
+    newtyps = files = NIL;
+    return 1;
+}
+
 /* Notice that the Miranda system has a two-level interrupt structure.
    1) Each evaluation (see rules.y) is an interruptible process.
    2) If the command loop is interrupted outside an evaluation or during
@@ -2460,6 +3486,8 @@ void privlib(void) { /* called when compiling <prelude>, adds some
     predef("changetype", I, wrong_t); /* wrong_t to prevent being typechecked */
     predef("first", HD, wrong_t);
     predef("rest", TL, wrong_t);
+    addtoenv(listdiff_fn); /* the action of "--", declared in prelude */
+    id_val(listdiff_fn) = LISTDIFF;
 /* the following added to make prelude compilable without stdenv */
     predef("code", CODE, undef_t);
     predef("concat", ap2(FOLDR, APPEND, NIL), undef_t);
@@ -2477,7 +3505,11 @@ void privlib(void) { /* called when compiling <prelude>, adds some
 
 void stdlib(void) { /* called when compiling <stdenv>, adds some
              internally defined identifiers to the environment  */
+    predef("amap", AMAP, undef_t);
     predef("arctan", ARCTAN_FN, undef_t);
+    predef("asize", ASIZE, undef_t);
+    predef("aslice", ASLICE, undef_t);
+    predef("asub", ASUB, undef_t);
     predef("code", CODE, undef_t);
     predef("cos", COS_FN, undef_t);
     predef("decode", DECODE, undef_t);
@@ -2491,16 +3523,27 @@ void stdlib(void) { /* called when compiling <stdenv>, adds some
     predef("foldl1", FOLDL1, undef_t); /* new at release 2 */
     predef("hugenum", sto_dbl(DBL_MAX), undef_t);
     predef("last", LIST_LAST, undef_t);
+    predef("lines", LINES, undef_t);
+    predef("listarray", LISTARRAY, undef_t);
+    predef("listtable", LISTTABLE, undef_t);
     predef("foldr", FOLDR, undef_t);
     predef("force", FORCE, undef_t);
     predef("getenv", GETENV, undef_t);
     predef("integer", INTEGER, undef_t);
+    predef("join", JOIN, undef_t);
     predef("log", LOG_FN, undef_t);
     predef("log10", LOG10_FN, undef_t); /* new at release 2 */
+    predef("lrumemo", MEMO, undef_t);
+    predef("memo", ap(MEMO, sto_int(0)), undef_t);
     predef("merge", MERGE, undef_t); /* new at release 2 */
+    predef("mkset", ap(MKSET, NIL), undef_t);
     predef("numval", NUMVAL, undef_t);
+    predef("par", PAR, undef_t);
+    predef("parmap", PARMAP, undef_t);
     predef("read", STARTREAD, undef_t);
     predef("readb", STARTREADBIN, undef_t);
+    predef("pseq", SEQ, undef_t);
+    predef("search", ap2(SEARCH, sto_int(0), sto_int(0)), undef_t);
     predef("seq", SEQ, undef_t);
     predef("shownum", SHOWNUM, undef_t);
     predef("showhex", SHOWHEX, undef_t);
@@ -2508,10 +3551,16 @@ void stdlib(void) { /* called when compiling <stdenv>, adds some
     predef("showfloat", SHOWFLOAT, undef_t); /* new at release 2 */
     predef("showscaled", SHOWSCALED, undef_t); /* new at release 2 */
     predef("sin", SIN_FN, undef_t);
+    predef("sort", SORT, undef_t);
+    predef("splitby", SPLIT, undef_t);
     predef("sqrt", SQRT_FN, undef_t);
     predef("system", EXEC, undef_t); /* new at release 2 */
     predef("take", TAKE, undef_t);
+    predef("tdelete", TDELETE, undef_t);
+    predef("tfold", TFOLD, undef_t);
+    predef("tinsert", TINSERT, undef_t);
     predef("tinynum", mktiny(), undef_t); /* new at release 2 */
+    predef("tlookup", TLOOKUP, undef_t);
     predef("zip2", ZIP, undef_t); /* new at release 2 */
 }
 
@@ -2532,8 +3581,53 @@ word size(word x) { /* measures the size of a compiled expression   */
     return s;
 }
 
+/* The compile cache.  If a directory is named by -cache or $MIRACACHE,
+   each dump made is also kept there, under a name formed from a hash of
+   everything the dump depends on, see cachekey(), and undump() looks there
+   before deciding to recompile.  A dump so found is loaded like any other,
+   so the hashes it records of its sources, see xfresh() in data.c, are
+   checked as well. */
+
+#define cachemix(h, v) (((h) ^ (unsigned long long)(v)) * 1099511628211ULL)
+
+static unsigned long long cachekey(const char *t, int depth) {
+    /* hash of the contents of script t, which hold the parameter bindings of
+       its %include directives, of XVERSION, and of the key of each file that t
+       %includes or %inserts - 0 if one of these cannot be found */
+    char line[BUFSIZE], path[pnlim];
+    unsigned long long h = fm_hash(t), k;
+    FILE *in;
+    int lit, ok = 1;
+    if (!h || depth > 12 || !(in = fopen(t, "r"))) return 0;
+    h = cachemix(h, XVERSION);
+    lit = litscript(t, in);
+    while (ok && fgets(line, sizeof(line), in)) {
+        if (!scandirective(t, line, lit, path)) continue;
+        if (!*path || !(k = cachekey(path, depth + 1))) ok = 0;
+        else h = cachemix(h, k);
+    }
+    fclose(in);
+    return !ok ? 0 : h ? h : 1;
+}
+
+static int cachename(char *c, size_t n, const char *t) {
+    unsigned long long h;
+    const char *b = strrchr(t, '/');
+    b = b ? b + 1 : t;
+    if (!cachedir || !*cachedir || !(h = cachekey(t, 0))) return 0;
+    return snprintf(c, n, "%s/%016llx-%.*s%s", cachedir, h, (int)strlen(b) - 1, b,
+                    obsuffix) < (int)n;
+}
+
+static void cachecp(const char *from, const char *to) { /* as filecp, but atomic */
+    char tmp[pnlim + 88];
+    if (snprintf(tmp, sizeof(tmp), "%s.%ld", to, (long)getpid()) >= (int)sizeof(tmp)) return;
+    filecp(from, tmp);
+    if (rename(tmp, to) == -1) unlink(tmp);
+}
+
 void makedump(void) {
-    char obf[pnlim];
+    char obf[pnlim], tmp[pnlim + 24], cache[pnlim + 64];
     FILE *f;
     // Ensure obf has enough space
     if (strlen(current_script) + strlen(obsuffix) >= sizeof(obf)) {
@@ -2543,7 +3637,10 @@ void makedump(void) {
     }
     (void)strcpy(obf, current_script);
     (void)strcpy(obf + strlen(obf) - 1, obsuffix);
-    f = fopen(obf, "w");
+    /* written under a temporary name and renamed, so that a process loading
+       the dump never sees it half written, see mkparallel() */
+    (void)snprintf(tmp, sizeof(tmp), "%s.%ld", obf, (long)getpid());
+    f = fopen(tmp, "w");
     if (!f) {
         printf("WARNING: CANNOT WRITE TO %s\n", obf);
         if (strcmp(current_script, PRELUDE) == 0 ||
@@ -2554,19 +3651,23 @@ void makedump(void) {
         return;
     }
     /* printf("dumping to %s\n",obf); /* DEBUG */
-    unlinkme = obf;
+    unlinkme = tmp;
     /* fchmod(fileno(f),0666); /* to make dumps writeable by all */ /* no! */
     setprefix(current_script);
     dump_script(files, f);
+    if (fclose(f) == EOF || rename(tmp, obf) == -1) {
+        unlink(tmp);
+        printf("WARNING: CANNOT WRITE TO %s\n", obf);
+        if (making && !make_status) make_status = 1;
+    } else if (cachename(cache, sizeof(cache), current_script)) cachecp(obf, cache);
     unlinkme = NULL;
-    (void)fclose(f);
 }
 
 void undump(char *t) { /* restore t from dump, or recompile if necessary */
-    extern word BAD_DUMP, CLASHES;
+    extern word BAD_DUMP, CLASHES, XTOUCHED;
     if (!normal(t) && !initialising) return loadfile(t);
     /* except for prelude, only .m files have dumps */
-    char obf[pnlim];
+    char obf[pnlim], cache[pnlim + 64];
     FILE *f;
     sighandler oldsig;
     size_t flen = strlen(t);
@@ -2579,10 +3680,13 @@ void undump(char *t) { /* restore t from dump, or recompile if necessary */
     (void)strcpy(obf + flen - 1, obsuffix);
     t2 = fm_time(obf);
     if (t2 && !t1) t2 = 0, unlink(obf); /* dump is orphan - remove */
-    if (!t2 || t2 < t1) { /* dump is nonexistent or older than source - ignore */
+    if ((!t2 || t2 < t1) && cachename(cache, sizeof(cache), t) && fm_time(cache))
+        cachecp(cache, obf), t2 = fm_time(obf);
+    if (!t2 || (t2 < t1 && !samesource(t))) { /* dump is nonexistent or out of date */
         loadfile(t);
         return;
-    }
+    } /* a dump older than its source is still tried if the source is
+         unchanged but for its mtime, see xfresh() in data.c */
     f = fopen(obf, "r");
     if (!f) {
         printf("cannot open %s\n", obf);
@@ -2598,7 +3702,9 @@ void undump(char *t) { /* restore t from dump, or recompile if necessary */
         sigflag = 0,
         oldsig = signal(SIGINT, (sighandler)sigdefer);
     /* can't take interrupt during load_script */
+    tstart();
     files = load_script(f, t, NIL, NIL, !making & !initialising);
+    tstop("load", t);
     (void)fclose(f);
     if (BAD_DUMP) {
         unlink(obf);
@@ -2627,11 +3733,15 @@ void undump(char *t) { /* restore t from dump, or recompile if necessary */
         if (ND != NIL || files == NIL) /* error in dump of PRELUDE */
             fprintf(stderr, "panic: %s contains errors\n", obf),
             exit(1);
+        if (XTOUCHED) makedump(); /* to record new mtimes, see xfresh() */
     } /* beware of dangling else ! (whence {}) */
-    else if (verbosity || magic || mkexports) /* for less silent making s/mkexports/making/ */
-        if (files == NIL) printf("%s contains syntax error\n", t);
-        else if (ND != NIL) printf("%s contains undefined names or type errors\n", t);
-        else if (!making && !magic) printf("%s\n", t); /* added &&!magic 26.11.2019 */
+    else {
+        if (XTOUCHED && files != NIL) makedump(); /* as above */
+        if (verbosity || magic || mkexports) /* for less silent making s/mkexports/making/ */
+            if (files == NIL) printf("%s contains syntax error\n", t);
+            else if (ND != NIL) printf("%s contains undefined names or type errors\n", t);
+            else if (!making && !magic) printf("%s\n", t); /* added &&!magic 26.11.2019 */
+    }
     if (files != NIL && !making & !initialising) unfixexports();
     loading = 0;
 }
@@ -132,15 +132,16 @@ word x,e;
 #define mkindex(i)  ((i)<256?(i):make(INT,i,0))
    /* will fall over if i >= IBASE */
 
-word abstrlist(x,e)  /* abstraction of list of variables x from code e */
-word x,e;
+word abstrlist(x,e,sub)  /* abstraction of list of variables x from code e */
+word x,e,sub; /* sub selects the i'th variable: (sub i) xs */
 { switch(tag[e])
   { case TCONS:
     case PAIR:
-    case CONS: return(liscomb(abstrlist(x,hd[e]),abstrlist(x,tl[e])));
+    case CONS: return(liscomb(abstrlist(x,hd[e],sub),abstrlist(x,tl[e],sub)));
     case AP: if(hd[e]==BADCASE||hd[e]==CONFERROR)
                return(ap(K,e)); /* don't go inside error info */
-             else return(combine(abstrlist(x,hd[e]),abstrlist(x,tl[e])));
+             else return(combine(abstrlist(x,hd[e],sub),
+                                 abstrlist(x,tl[e],sub)));
     case LAMBDA: case LET: case LETREC: case TRIES: case LABEL: case SHOW:
     case LEXER:
     case SHARE: fprintf(stderr,
@@ -149,7 +150,7 @@ word x,e;
     default: { word i=0;
 	       while(x!=NIL&&hd[x]!=e)i++,x=tl[x];
 	       if(x==NIL)return(ap(K,e));
-	       return(ap(SUBSCRIPT,mkindex(i))); }
+	       return(ap(sub,mkindex(i))); }
 }}
 
 word rv_script=0; /* flags readvals in use (for garbage collector) */
@@ -186,7 +187,7 @@ word x;
                 rule=abstr(mklexvar(1),rule);
                 if(!(tag[rule]==AP&&hd[rule]==K))uses_state=1;
                 r=cons(cons(hd[hd[x]], /* start condition stuff */
-                            cons(ap(hd[tl[hd[x]]],NIL),   /* matcher [] */
+                            cons(hd[tl[hd[x]]],  /* regexp, see lexmatch */
                                  rule)),
                        r);
                 x=tl[x]; }
@@ -417,9 +418,11 @@ word d,e;
 /* nasty bug, codegen(dval(x)) was interfering with abstract(dlhs(x)...
    to fix made codegen on tuples be NOT in situ 20/11/88  */
 
+#define BIGLETREC 8 /* larger groups are held as arrays, see transletrec */
+
 word transletrec(dd,e) /* better method,  using list indexing - Jan 88 */
 word e,dd;
-{ word lhs=NIL,rhs=NIL,pn=1;
+{ word lhs=NIL,rhs=NIL,pn=1,n=0,sub;
   /* list of defs (x=e) is combined to listwise def `xs=es' */
   for(;dd!=NIL;dd=tl[dd])
      { word x=hd[dd];
@@ -436,9 +439,18 @@ word e,dd;
      }
   if(tl[lhs]==NIL) /* singleton */
     return(ap(abstr(hd[lhs],codegen(e)),ap(Y,abstr(hd[lhs],hd[rhs]))));
-  return(ap(abstrlist(lhs,codegen(e)),ap(Y,abstrlist(lhs,rhs))));
-}
-/* note 1: we here use the alternative `mklazy' transformation
+  for(sub=lhs;sub!=NIL;sub=tl[sub])n++;
+  if(n<=BIGLETREC)
+    return(ap(abstrlist(lhs,codegen(e),SUBSCRIPT),
+              ap(Y,abstrlist(lhs,rhs,SUBSCRIPT))));
+  sub=ap(C,ASUB);
+  return(ap(abstrlist(lhs,codegen(e),sub),
+            ap(Y,ap2(B,LISTARRAY,abstrlist(lhs,rhs,sub)))));
+}
+/* a group of more than BIGLETREC definitions is made into an array, so
+   that each occurrence of a name in it costs one step to find, not one for
+   each name before it in the list
+   note 1: we here use the alternative `mklazy' transformation
    pat = e =>  x1=p!0;...;xn=p!(n-1);p=(lambda(pat)[xs])e|conferror;
    where p is a private name (need be unique only within a given letrec)
 */
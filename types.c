@@ -11,7 +11,9 @@
 #include "data.h"
 #include "lex.h"
 #include "big.h"
-word R=NIL;  /* direct-and-indirect dependency graph */
+#include <errno.h>
+#include <fcntl.h>
+word R=NIL;  /* direct dependency graph */
 word TABSTRS=NIL; /* list of abstype declarations */
 word ND;  /* undefined names used in script */
 word SBND; /* names specified but not defined (handled separately) */
@@ -24,17 +26,17 @@ word current_id=0,lastloc=0,lineptr=0;   /* used to locate type errors */
 word showchain=NIL; /* links together all occurrences of special forms (show)
 		      encountered during typecheck */
 extern word rfl;
+word tcache=NIL,tcfresh=NIL; /* types kept for reuse, see infer_type */
 
 #include <setjmp.h>
 jmp_buf env1; /* for longjmp - see man (3) setjmp */
 
 static void abstr_check(word);
 static void abstr_mcheck(word);
-static void addsubst(word,word);
 static word ap_subst(word,word);
 static void checkfbs(void);
-static int clear_SUBST(void);
 static void comp_deps(word);
+static word components(word);
 static word conforms(word,word,word,word);
 static word cyclic_abstr(word);
 static word etype(word,word,word);
@@ -47,6 +49,7 @@ static void locate_inc(void);
 static void mcheckfbs(void);
 static word meta_tcheck(word);
 static int non_generic(word);
+static word ngtvar(void);
 static int occurs(word,word);
 static void out_formal(FILE*,word);
 static void out_formal1(FILE*,word);
@@ -54,6 +57,7 @@ static void out_type1(word);
 static void out_type2(word);
 static void out_typel(word);
 static void printelement(word);
+static word prune(word);
 static void redtfr(word);
 static word rembvars(word,word);
 static word remove1(word,word*);
@@ -62,6 +66,22 @@ static void sterilise(word);
 static word subst(word);
 static word subsu1(word,word,word);
 static word tail(word);
+static word tcfind(word,unsigned long);
+static unsigned long tchash(word,unsigned long);
+static unsigned long tcidhash(word,unsigned long);
+static void tckeep(word,unsigned long,word);
+static unsigned long tckey(word);
+static void tcnote(word,unsigned long,word);
+static void tcswap(word);
+static void tw_fork(word);
+static void tw_plan(word);
+static void tw_recv(word);
+static word twgrow(void);
+static word twread(int,char *,long);
+static void tw_take(word);
+static word tw_type(word);
+static word tw_untype(word **);
+static void tw_work(word,word,int);
 static void txchange(word,word);
 static void type_error(char*,char*,word,word);
 static void type_error1(word);
@@ -73,23 +93,27 @@ static void type_error6(word,word,word);
 static void type_error7(word,word);
 static void type_error8(word,word);
 static word ult(word);
+static void tvbind(word,word);
+static void tvmark(word);
 static int unify(word,word);
 static int unify1(word,word);
 
 void checktypes() /* outcome indicated by setting of flags SYNERR, TYPERRS, ND */
-{ word s;
+{ word s,i;
   extern word freeids,SYNERR,fnts;
   ATNAMES=TYPERRS=0;
   NT=R=SBND=ND=NIL;  /* NT=R= added 4/6/88 */
+  tcswap(0);
+  tstart();
   if(setjmp(env1)==1)goto L;
   if(rfl!=NIL)readoption();
   for(s=reverse(fil_defs(hd[files]));s!=NIL;s=tl[s])
      comp_deps(hd[s]);  /* for each identifier in current script, compute
 			      dependencies to form R */
-  R=tclos(sortrel(R));
   if(FBS!=NIL)mcheckfbs();
   abstr_mcheck(TABSTRS);
-L:if(TYPERRS)
+L:tstop("comp_deps",0);
+  if(TYPERRS)
     { /* badly formed types, so give up */
       TABSTRS=NT=R=NIL;
       printf("typecheck cannot proceed - compilation abandoned\n");
@@ -97,14 +121,22 @@ L:if(TYPERRS)
       return; }
   if(freeids!=NIL)redtfr(freeids);
   /* printgraph("dependency analysis:",R); /* for debugging */
+  tstart();
   genshfns();
   if(fnts!=NIL)genbnft();
-  R=msc(R);
-  /* printgraph("strong components:",R); /* for debugging */
-  s=tsort(R);
-  /* printlist("topological sort:",s); /* for debugging */
+  tstop("genshfns",0);
+  tstart();
+  s=components(R);
+  tstop("components",0);
+  /* printlist("strong components:",s); /* for debugging */
+  tw_plan(s);
   NT=R=NIL; /* must be invariant across the call */
-  while(s!=NIL)infer_type(hd[s]),s=tl[s];
+  tstart();
+  for(i=0;s!=NIL;s=tl[s],i++)
+     tw_take(i),infer_type(hd[s]);
+  tw_stop();
+  tstop("infer_type",0);
+  tcswap(1);
   checkfbs();
   while(TABSTRS!=NIL)
        abstr_check(hd[TABSTRS]),TABSTRS=tl[TABSTRS];
@@ -121,12 +153,14 @@ L:if(TYPERRS)
    let graph2 ::= list(cons(element,list(id)))
    we define:
    comp_deps(id)->builds R::graph1, direct dependencies
-   R=tclos(sortrel(R))::graph1, direct and indirect dependencies
-   msc(R)->collects maximal strong components in R, now R::graph2
-   tsort(graph2)->list(element), topologically sorted
+   components(R)->list(element), the maximal strong components of R,
+		  topologically sorted
    infer_type(element)->fills in the id_type field(s) of element
+   (msc and tsort below do the same job in two steps, given the transitive
+   closure of a graph - they are still used by trans.c)
+   components independent of each other may be inferred by worker
+   processes, see tw_plan()
 */
-/* R occupies quadratic worst-case space - does anyone know a better way? */
 
 void comp_deps(n) /* adds to R an entry of the form cons(n,RHS) where n is an
 		identifier and RHS is a list of all the identifiers in the
@@ -180,6 +214,71 @@ word n;
   R=cons(cons(n,rhs),R);
 }
 
+/* components() is Tarjan's algorithm, which finds the strong components
+   of a graph in one depth first search, in time and space linear in the
+   size of the graph.  A component is completed only after every
+   component reachable from it, so they come out in dependency order.  The
+   search is done with an explicit stack, to allow for long chains of
+   definitions.  The nodes are found from identifiers by open hashing */
+
+struct scnode { word id,rhs,index,low,self,done; };
+#define scslot(id,n) ((((unsigned long)(id))*2654435761UL)&((n)-1))
+static struct scnode *scv;
+
+static int sccmp(a,b)
+const void *a,*b;
+{ word x=scv[*(word *)a].id,y=scv[*(word *)b].id;
+  return(x<y?-1:x>y);
+}
+
+word components(g) /* returns list(element) for g::graph1, see NOTES */
+word g;
+{ struct scnode *v;
+  word n=0,tsize=64,*tab,*stack,*cs,sp=0,top=0,count=0,r=NIL,i,j,g1;
+  for(g1=g;g1!=NIL;g1=tl[g1])n++;
+  while(tsize<2*n)tsize*=2;
+  v=(struct scnode *)malloc((n+1)*sizeof(struct scnode));
+  tab=(word *)malloc(tsize*sizeof(word));
+  stack=(word *)malloc((n+1)*sizeof(word));
+  cs=(word *)malloc((n+1)*sizeof(word));
+  if(v==NULL||tab==NULL||stack==NULL||cs==NULL)mallocfail("dependency graph");
+  for(i=0;i<tsize;i++)tab[i]= -1;
+  for(i=0,g1=g;g1!=NIL;i++,g1=tl[g1])
+     { v[i].id=hd[hd[g1]],v[i].rhs=tl[hd[g1]];
+       v[i].index=v[i].low=v[i].self=v[i].done=0;
+       for(j=scslot(v[i].id,tsize);tab[j]>=0;j=(j+1)&(tsize-1));
+       tab[j]=i; }
+  for(i=0;i<n;i++)
+     { if(v[i].index)continue;
+       v[i].index=v[i].low= ++count,stack[sp++]=i,cs[top++]=i;
+       while(top)
+	    { word x=cs[top-1],y;
+	      if(v[x].rhs!=NIL) /* next edge */
+		{ word id=hd[v[x].rhs];
+		  v[x].rhs=tl[v[x].rhs];
+		  for(j=scslot(id,tsize);tab[j]>=0&&v[tab[j]].id!=id;
+		      j=(j+1)&(tsize-1));
+		  if((y=tab[j])<0)continue; /* not in graph */
+		  if(y==x)v[x].self=1; else
+		  if(!v[y].index)
+		    v[y].index=v[y].low= ++count,stack[sp++]=y,cs[top++]=y; else
+		  if(!v[y].done&&v[y].index<v[x].low)v[x].low=v[y].index;
+		  continue; }
+	      if(--top&&v[x].low<v[cs[top-1]].low)v[cs[top-1]].low=v[x].low;
+	      if(v[x].low!=v[x].index)continue;
+	      if(stack[sp-1]==x&&!v[x].self) /* not recursive */
+		{ v[x].done=1,sp--;
+		  r=cons(v[x].id,r);
+		  continue; }
+	      for(j=sp;stack[--j]!=x;);
+	      scv=v,qsort(stack+j,sp-j,sizeof(word),sccmp);
+	      r=cons(NIL,r);  /* group is kept in ascending address order */
+	      while(sp>j)y=stack[--sp],v[y].done=1,hd[r]=cons(v[y].id,hd[r]); }
+     }
+  free(v),free(tab),free(stack),free(cs);
+  return(reverse(r));
+}
+
 word tsort(g) /* topological sort - returns a list of the elements in the domain
   of relation g, in an order such that each element is preceded by everything
   it depends on */
@@ -321,13 +420,167 @@ word t;
 word tvcount=1;
 #define NTV mktvar(tvcount++)
   /* brand new type variable */
-#define reset_SUBST  (current_id=tvcount>=hashsize?clear_SUBST():0)
+
+/* A type variable is bound by overwriting its hd field (see mktvar), so
+   the substitution found by unify is held in the types themselves, as a
+   union-find forest - an unbound variable stands for all those bound to
+   it.  Paths are compressed by prune() and var-var unions go by rank.  The
+   hd of an unbound variable is negative, -1-info, where info holds its
+   rank and the flag TV_NG, which is set on any variable that has been
+   reachable from a non-generic one.  A variable without TV_NG is generic
+   wherever it appears, so non_generic() need only search NGT for those
+   with it */
+
+#define tvbound(tv) (hd[tv]>=0)
+#define tvinfo(tv) (-1-hd[tv])
+#define TV_NG 64
+#define TV_RANK 63
+
+/* incremental typechecking - the type found for each identifier is kept,
+   under a hash of its definition and of the types of everything that
+   mentions, so that when the script is next compiled (after an edit, say)
+   only the elements whose definitions or context have changed need be
+   checked again.  Definitions whose checking has side effects (show,
+   readvals, %lex, %bnf) or that mention undefined names are not kept.
+   The tables are keyed by identifier and live from one checktypes() to
+   the next - tcache and tcfresh hold the types for the garbage collector.
+   Types are kept from one run to the next only if typecache is set (flag
+   -typecache), but are looked up within a run by parallel inference too */
+
+static struct tcent { word id,t; unsigned long h; } *tcold=NULL,*tcnew=NULL;
+static word tcoldsize=0,tcnewsize=0,tcoldcount=0,tcnewcount=0,tcfail,tcbudget;
+static word tcuse=0; /* whether infer_type() hashes definitions this run */
+#define tcmix(h,v) (((h)^(unsigned long)(v))*1099511628211UL)
+#define tcslot(id,n) ((((unsigned long)(id))*2654435761UL)&((n)-1))
+
+void tcswap(done)  /* start (0) or finish (1) a run of infer_type */
+word done;
+{ extern int typecache;
+  word n=64,k=0,d;
+  if(done)
+    { free(tcold);
+      tcold=tcnew,tcoldsize=tcnewsize,tcoldcount=tcnewcount;
+      tcache=tcfresh;
+      tcnew=NULL,tcnewsize=0,tcfresh=NIL;
+      return; }
+  free(tcnew);
+  if(!typecache) /* nothing from the last run */
+    { free(tcold);
+      tcold=NULL,tcoldsize=tcoldcount=0;
+      tcache=NIL; }
+  tcuse=typecache;
+  for(d=fil_defs(hd[files]);d!=NIL;d=tl[d])k++;
+  while(n<2*k)n*=2;
+  tcnew=(struct tcent *)calloc(n,sizeof(struct tcent));
+  tcnewsize=tcnew?n:0;
+  tcnewcount=0;
+  tcfresh=NIL;
+}
+
+word tcfind(x,h)  /* type kept for x under hash h, 0 if none */
+word x;
+unsigned long h;
+{ word i;
+  if(!h||!tcoldsize)return(0);
+  for(i=tcslot(x,tcoldsize);tcold[i].id;i=(i+1)&(tcoldsize-1))
+     if(tcold[i].id==x)return(tcold[i].h==h?tcold[i].t:0);
+  return(0);
+}
+
+void tcnote(x,h,t)  /* keep type t of x, under hash h */
+word x,t;
+unsigned long h;
+{ word i;
+  if(!h||!tcnewsize||t==wrong_t)return;
+  for(i=tcslot(x,tcnewsize);tcnew[i].id&&tcnew[i].id!=x;i=(i+1)&(tcnewsize-1));
+  if(!tcnew[i].id)tcnewcount++;
+  tcnew[i].id=x,tcnew[i].h=h,tcnew[i].t=t;
+  tcfresh=cons(t,tcfresh);
+}
+
+void tckeep(x,h,t)  /* add type t of x, under hash h, to those kept from the
+                       last run - see tw_take(), the caller protects t */
+word x,t;
+unsigned long h;
+{ word i;
+  if(2*(tcoldcount+1)>tcoldsize)
+    { struct tcent *old=tcold;
+      word n=tcoldsize;
+      tcold=(struct tcent *)calloc(n?2*n:64,sizeof(struct tcent));
+      if(tcold==NULL){ tcold=old; return; }
+      tcoldsize=n?2*n:64,tcoldcount=0;
+      for(i=0;i<n;i++)
+         if(old[i].id)tckeep(old[i].id,old[i].h,old[i].t);
+      free(old); }
+  for(i=tcslot(x,tcoldsize);tcold[i].id&&tcold[i].id!=x;i=(i+1)&(tcoldsize-1));
+  if(!tcold[i].id)tcoldcount++;
+  tcold[i].id=x,tcold[i].h=h,tcold[i].t=t;
+}
+
+unsigned long tckey(x)  /* hash under which the type of identifier x is kept,
+                           0 if it is not to be */
+word x;
+{ extern word fnts;
+  unsigned long h;
+  word d;
+  tcfail=fnts!=NIL,tcbudget=100000; /* %bnf types are per script */
+  h=tchash(id_val(x),tcidhash(x,0));
+  for(d=tcfail?NIL:deps(id_val(x));d!=NIL;d=tl[d])
+     if(id_type(hd[d])==undef_t&&id_val(hd[d])==UNDEF)
+       tcfail=1; /* reported as undefined each time */
+  return(tcfail?0:h);
+}
+
+unsigned long tchash(x,h)  /* hash of expression or type x, continuing h */
+word x;
+unsigned long h;
+{ while(!tcfail)
+  { if(--tcbudget<0){ tcfail=1; break; }
+    h=tcmix(h,tag[x]);
+    switch(tag[x])
+    { case ATOM: if(x==G_END||x==G_STATE||x==G_CLOSE)tcfail=1;
+                 return(tcmix(h,x));
+      case DOUBLE:
+      case UNICODE: return(tcmix(tcmix(h,hd[x]),tl[x]));
+      case TVAR: return(tcmix(h,tl[x]));
+      case FILEINFO: return(h); /* position only */
+      case INT: h=tcmix(h,hd[x]);
+                if(!tl[x])return(h);
+                x=tl[x]; continue;
+      case CONSTRUCTOR: h=tcmix(h,hd[x]); x=tl[x]; continue;
+      case ID: return(tcidhash(x,h));
+      case SHARE: x=hd[x]; continue;
+      case DATAPAIR: case STRCONS: case SHOW: case STARTREADVALS: case LEXER:
+                 tcfail=1; return(h);
+      default: h=tchash(hd[x],h); x=tl[x];
+    }
+  }
+  return(h);
+}
+
+unsigned long tcidhash(x,h)  /* an identifier, by name and type */
+word x;
+unsigned long h;
+{ char *p=get_id(x);
+  word t=id_type(x);
+  while(*p)h=tcmix(h,*p++);
+  if(t==type_t)
+    { h=tcmix(tcmix(h,t_class(x)),t_arity(x));
+      return(t_class(x)==synonym_t?tchash(t_info(x),h):h); }
+  if(t==wrong_t)
+    { tcfail=1; return(h); } /* reported as an error */
+  return(t==undef_t?h:tchash(t,h));
+}
 
 void infer_type(x) /* deduces the types of the identifiers in x - no result,
                   works by filling in id_type fields */
 word x; /* x is an "element" */
-{ if(tag[x]==ID)
+{ unsigned long h;
+  if(tag[x]==ID)
     { word t,oldte=TYPERRS;
+      h=tcuse?tckey(x):0;
+      if((t=tcfind(x,h)))
+        { id_type(x)=t; tcnote(x,h,t); return; }
       current_id=x;
       t = subst(etype(id_val(x),NIL,NIL));
       if(id_type(x)==undef_t)id_type(x)=redtvars(t);
@@ -342,26 +595,273 @@ word x; /* x is an "element" */
       if(TYPERRS>oldte)id_type(x)=wrong_t,
 		       id_val(x)=UNDEF,
 		       ND=add1(x,ND);
-      reset_SUBST; }
+      else tcnote(x,h,id_type(x));
+      current_id=0; }
   else{ /* recursive group of names */
-	word x1,oldte,ngt=NIL;
+	word x1,oldte,ngt=NIL,hs=NIL,reuse=1,ok=1;
+	for(x1=x;x1!=NIL;x1=tl[x1]) /* hashes, kept in hs */
+	   { h=tcuse?tckey(hd[x1]):0;
+	     if(!tcfind(hd[x1],h))reuse=0;
+	     hs=strcons(h,hs); }
+	for(x1=hs,hs=NIL;x1!=NIL;x1=tl[x1])hs=strcons(hd[x1],hs);
+	if(reuse)
+	  { for(x1=x;x1!=NIL;x1=tl[x1])
+	       id_type(hd[x1])=tcfind(hd[x1],hd[hs]),
+	       tcnote(hd[x1],hd[hs],id_type(hd[x1])),
+	       hs=tl[hs];
+	    return; }
 	for(x1=x;x1!=NIL;x1=tl[x1])
-	   ngt=cons(NTV,ngt),
+	   ngt=cons(ngtvar(),ngt),
 	   id_type(hd[x1])=ap(bind_t,hd[ngt]);
 	for(x1=x;x1!=NIL;x1=tl[x1])
 	   { oldte=TYPERRS,
              current_id=hd[x1],
 	     unify(tl[id_type(hd[x1])],etype(id_val(hd[x1]),NIL,ngt));
-	     if(TYPERRS>oldte)
+	     if(TYPERRS>oldte)ok=0,
 	       id_type(hd[x1])=wrong_t,
 		id_val(hd[x1])=UNDEF,ND=add1(hd[x1],ND); }
 	for(x1=x;x1!=NIL;x1=tl[x1])
 	   if(id_type(hd[x1])!=wrong_t)
 	     id_type(hd[x1])=redtvars(ult(tl[id_type(hd[x1])]));
-        reset_SUBST;
+	if(ok)for(x1=x;x1!=NIL;x1=tl[x1],hs=tl[hs])
+	        tcnote(hd[x1],hd[hs],id_type(hd[x1]));
+        current_id=0;
       } 
 }
 
+/* parallel inference - if partypes is set (flag -partypes) and there are
+   processors to spare, components
+   independent of each other are inferred by worker processes forked for
+   the purpose.  The heap cannot be shared, so a worker has a copy of it as
+   it was at the fork, and is given only components whose dependencies had
+   all been inferred by then, and only those whose types infer_type() would
+   keep (see tchash) - checking the others writes into the code.  A worker
+   infers its share in order, and sends back the type of each identifier
+   down a pipe, cell by cell, a typename by its address, which is the same
+   in both heaps.  The parent, coming to such a component in its own pass
+   through the list, reads the types and adds them to those kept from the
+   last run, so that infer_type() takes them up as it would those.  When a
+   worker finds a type error the component is inferred again by the parent,
+   so that errors are reported as by a serial check.  Workers are forked
+   for a batch of TWBATCH or more components at a time, the parent keeping
+   a share. */
+
+#define TWBATCH 64
+#define TWMAX 64
+static word tw_nw= -1,tw_n=0,tw_ready,tw_busy;
+static word *tw_el,*tw_maxd,*tw_own,*tw_link,*tw_head,*tw_pool,tw_npool;
+  /* for the component at position i: its element, the last position it
+     depends on, and who infers it - worker w>=0, parent -1, parent unless
+     shared out -2 (is ready, in tw_pool), -3 (to be shared out).  tw_head
+     by last position+1 and tw_link chain those that become ready together */
+static struct { pid_t pid; int fd; word left; } tw_w[TWMAX];
+static word *twbuf=NULL,twlen,twsize=0;
+static unsigned char *tw_ids; /* in a worker, the ID cells at the fork */
+static word tw_idtop;
+
+void tw_plan(s) /* s is the list of components, R their dependencies */
+word s;
+{ extern int partypes;
+  struct twent { word id,i; } *m;
+  word n=0,k=0,i,j,x,y,size=64;
+  tw_n=0;
+  if(!partypes)return;
+  if(tw_nw<0)
+    { tw_nw=sysconf(_SC_NPROCESSORS_ONLN)-1;
+      if(tw_nw<0)tw_nw=0;
+      if(tw_nw>TWMAX)tw_nw=TWMAX; }
+  for(x=s;x!=NIL;x=tl[x],n++)
+     if(tag[hd[x]]==ID)k++; else
+     for(y=hd[x];y!=NIL;y=tl[y])k++;
+  if(tw_nw==0||n<TWBATCH)return;
+  while(size<2*k)size*=2;
+  m=(struct twent *)calloc(size,sizeof(struct twent));
+  tw_el=(word *)malloc(6*n*sizeof(word));
+  if(m==NULL||tw_el==NULL){ free(m),free(tw_el); return; }
+  tw_maxd=tw_el+n,tw_own=tw_maxd+n,tw_link=tw_own+n,tw_pool=tw_link+n;
+  tw_head=tw_pool+n; /* n of them, the last position is no one's dependency */
+#define twslot(x) ((((unsigned long)(x))*2654435761UL)&(size-1))
+  for(i=0;s!=NIL;s=tl[s],i++)
+     { tw_el[i]=x=hd[s],tw_maxd[i]= -1,tw_own[i]= -1,tw_head[i]= -1;
+       for(y=tag[x]==ID?cons(x,NIL):x;y!=NIL;y=tl[y])
+          { for(j=twslot(hd[y]);m[j].id;j=(j+1)&(size-1))
+               ;
+            m[j].id=hd[y],m[j].i=i; } }
+  for(x=R;x!=NIL;x=tl[x])
+     { for(j=twslot(hd[hd[x]]);m[j].id&&m[j].id!=hd[hd[x]];j=(j+1)&(size-1))
+          ;
+       if(!m[j].id)continue;
+       i=m[j].i;
+       for(y=tl[hd[x]];y!=NIL;y=tl[y])
+          { for(j=twslot(hd[y]);m[j].id&&m[j].id!=hd[y];j=(j+1)&(size-1))
+               ;
+            if(m[j].id&&m[j].i!=i&&m[j].i>tw_maxd[i])tw_maxd[i]=m[j].i; } }
+#undef twslot
+  free(m);
+  for(i=n;i--;)
+     tw_link[i]=tw_head[tw_maxd[i]+1],tw_head[tw_maxd[i]+1]=i;
+  tw_n=n,tw_npool=tw_ready=tw_busy=0;
+  tcuse=1; /* types from workers are looked up by hash */
+}
+
+void tw_take(i) /* called before the component at position i is inferred */
+word i;
+{ word j;
+  if(i>=tw_n)return;
+  for(j=tw_head[i];j>=0;j=tw_link[j]) /* ready, now 0..i-1 are done */
+     tw_own[j]= -2,tw_pool[tw_npool++]=j,tw_ready++;
+  if(tw_own[i]== -2)tw_own[i]= -1,tw_ready--;
+  if(tw_busy==0&&tw_ready>=TWBATCH)tw_fork(i);
+  if(tw_own[i]>=0)tw_recv(tw_own[i]);
+}
+
+void tw_fork(i) /* shares out the components now ready, all after i */
+word i;
+{ word j,k,w,x,y,c=0,keep;
+  int fd[2];
+  pid_t pid;
+  for(k=0;k<tw_npool;k++)
+     if(tw_own[j=tw_pool[k]]== -2)
+       { for(keep=1,x=tw_el[j],y=tag[x]==ID?cons(x,NIL):x;y!=NIL;y=tl[y])
+            if(!tckey(hd[y]))keep=0;
+         tw_own[j]=keep?-3:-1,c+=keep; }
+  tw_npool=tw_ready=0;
+  for(k=0,j=i+1;j<tw_n;j++)
+     if(tw_own[j]== -3)
+       tw_own[j]=c<TWBATCH||(w=k++%(tw_nw+1))==tw_nw?-1:w;
+  if(c<TWBATCH)return;
+  fflush(NULL); /* or a worker might write what is buffered a second time */
+  for(w=0;w<tw_nw;w++)
+     { for(tw_w[w].left=0,j=i+1;j<tw_n;j++)
+          if(tw_own[j]==w)tw_w[w].left++;
+       if(tw_w[w].left==0)continue;
+       if(pipe(fd)== -1)break;
+       if((pid=fork())== -1){ close(fd[0]),close(fd[1]); break; }
+       if(pid==0)
+         { int null=open("/dev/null",O_WRONLY);
+           (void)signal(SIGINT,SIG_DFL);
+           for(k=0;k<w;k++)if(tw_w[k].left)close(tw_w[k].fd);
+           close(fd[0]);
+           if(null>=0)dup2(null,1),dup2(null,2); /* errors are left to the parent */
+           tw_work(w,i,fd[1]); }
+       close(fd[1]);
+       tw_w[w].pid=pid,tw_w[w].fd=fd[0];
+       tw_busy++; }
+  for(;w<tw_nw;w++) /* could not be forked */
+     for(tw_w[w].left=0,j=i+1;j<tw_n;j++)
+        if(tw_own[j]==w)tw_own[j]= -1;
+}
+
+#define twput(x) (twlen==twsize?twgrow():0,twbuf[twlen++]=(x))
+word twgrow()
+{ twsize=twsize?2*twsize:1024;
+  twbuf=(word *)realloc(twbuf,twsize*sizeof(word));
+  if(twbuf==NULL)mallocfail("type worker");
+  return(0);
+}
+
+void tw_work(w,i,fd) /* body of worker w - does not return - each component
+                        is sent as its length in words, the number k of its
+                        identifiers (0 if it could not be typed), then k
+                        triples of identifier, hash and type */
+word w,i;
+int fd;
+{ extern word SPACE;
+  word j,x,y,hs,ok;
+  long n,m;
+  tw_idtop=TOP;
+  tw_ids=(unsigned char *)calloc((TOP-ATOMLIMIT)/8+1,1);
+  if(tw_ids==NULL)_exit(1); /* the parent infers the lot */
+  for(x=ATOMLIMIT;x<TOP;x++)
+     if(tag[x]==ID)tw_ids[(x-ATOMLIMIT)>>3]|=1<<((x-ATOMLIMIT)&7);
+  for(j=i+1;j<tw_n;j++)
+     if(tw_own[j]==w)
+       { x=tw_el[j],x=tag[x]==ID?cons(x,NIL):x;
+         for(hs=NIL,y=x;y!=NIL;y=tl[y])hs=strcons(tckey(hd[y]),hs);
+         ok=TYPERRS;
+         infer_type(tw_el[j]);
+         ok=TYPERRS==ok;
+         twlen=0;
+         twput(0),twput(0);
+         for(hs=reverse(hs);ok&&x!=NIL;x=tl[x],hs=tl[hs])
+            twput(hd[x]),twput(hd[hs]),twbuf[1]++,
+            ok=tw_type(id_type(hd[x]));
+         if(!ok)twlen=2,twbuf[1]=0;
+         twbuf[0]=twlen-1;
+         for(n=0,m=twlen*sizeof(word);n<m;n+=y)
+            if((y=write(fd,(char *)twbuf+n,m-n))<=0&&errno!=EINTR)_exit(1);
+            else if(y<0)y=0; }
+  _exit(0);
+}
+
+word tw_type(t) /* puts type t in twbuf, returning 0 if it cannot be sent */
+word t;
+{ extern word SPACE;
+  while(tag[t]==AP)
+       { twput(AP);
+         if(!tw_type(hd[t]))return(0);
+         t=tl[t]; }
+  if(tag[t]==TVAR){ twput(TVAR),twput(hd[t]),twput(tl[t]); return(1); }
+  if(isptr(t)&&(tag[t]!=ID||t>=tw_idtop||
+     !(tw_ids[(t-ATOMLIMIT)>>3]>>((t-ATOMLIMIT)&7)&1)))
+    return(0); /* made since the fork */
+  twput(ATOM),twput(t);
+  return(1);
+}
+
+word tw_untype(p) /* the type starting at *p, which is moved on past it */
+word **p;
+{ word c= *(*p)++,a,b;
+  if(c==AP){ a=tw_untype(p); b=tw_untype(p); return(ap(a,b)); }
+  a= *(*p)++;
+  if(c==TVAR){ b= *(*p)++; return(make(TVAR,a,b)); }
+  return(a);
+}
+
+word twread(fd,b,n) /* n bytes from fd into b - 0 if there are not */
+int fd;
+char *b;
+long n;
+{ long k;
+  while(n>0)
+       if((k=read(fd,b,n))>0)b+=k,n-=k; else
+       if(k==0||errno!=EINTR)return(0);
+  return(1);
+}
+
+void tw_recv(w) /* takes the next component sent by worker w, see tw_work() */
+word w;
+{ word n,k,*p,x,t;
+  unsigned long h;
+  int fd=tw_w[w].fd;
+  if(fd>=0)
+    { if(twread(fd,(char *)&n,sizeof(word))&&n>0)
+        { while(twsize<n)twgrow();
+          if(!twread(fd,(char *)twbuf,n*sizeof(word)))n=0; }
+      if(n<=0)close(fd),tw_w[w].fd=fd= -1; } /* the worker has died */
+  if(fd>=0)
+    for(p=twbuf+1,k=twbuf[0];k--;)
+       { x= *p++,h= *p++;
+         t=tw_untype(&p);
+         tckeep(x,h,t);
+         tcache=cons(t,tcache); }
+  if(--tw_w[w].left==0)
+    { if(fd>=0)close(fd);
+      while(waitpid(tw_w[w].pid,NULL,0)== -1&&errno==EINTR);
+      tw_busy--; }
+}
+
+void tw_stop() /* at the end of checktypes(), or on an interrupt */
+{ word w;
+  for(w=0;tw_busy&&w<tw_nw;w++)
+     if(tw_w[w].left)
+       { kill(tw_w[w].pid,SIGKILL);
+         if(tw_w[w].fd>=0)close(tw_w[w].fd);
+         while(waitpid(tw_w[w].pid,NULL,0)== -1&&errno==EINTR);
+         tw_w[w].left=0,tw_busy--; }
+  if(tw_n)free(tw_el),tw_n=0;
+}
+
 word hereinc; /* location of currently-being-processed %include */
 word lasthereinc;
 
@@ -435,7 +935,7 @@ void checkfbs()
       TABSTRS=NT=R=NIL;
       printf("compilation abandoned\n");
       SYNERR=1; }
-  reset_SUBST;
+  current_id=0;
 }
 
 word fix_type(t)  /* substitute out any indirected typenames in t */
@@ -500,7 +1000,7 @@ word x;
 	   sayhere(id_who(hd[x]),1); }
        if(TYPERRS>oldte)
 	 id_type(hd[x])=wrong_t,id_val(hd[x])=UNDEF,ND=add1(hd[x],ND);
-       reset_SUBST; }
+       current_id=0; }
   /* restore the abstract types - for "finger" */
   for(x=sigids;x!=NIL;x=tl[x],rtypes=tl[rtypes])
      if(id_type(hd[x])!=wrong_t)id_type(hd[x])=hd[rtypes];
@@ -603,7 +1103,7 @@ word checktype(x)  /* is expression x well-typed ? */
 word x;
 { TYPERRS=0;
   etype(x,NIL,NIL);
-  reset_SUBST;
+  current_id=0;
   return(!TYPERRS);
 }
 
@@ -730,13 +1230,13 @@ word ngt;     /* ngt is list of non-generic type variables */
 		  return(NTV); }
 	      if(a==wrong_t)return(NTV);
               return(instantiate(ATNAMES?rep_t(a,ATNAMES):a));
-    case LAMBDA: a=NTV; b=NTV;
+    case LAMBDA: a=ngtvar(); b=NTV;
 		 d=cons(a,ngt);
 		 c=conforms(hd[x],a,env,d);
 		 if(c==-1||!unify(b,etype(tl[x],c,d)))return(NTV);
 		 return(tf(a,b));
     case LET: { word e,def=hd[x];
-		a=NTV,e=conforms(dlhs(def),a,env,cons(a,ngt));
+		a=ngtvar(),e=conforms(dlhs(def),a,env,cons(a,ngt));
 		current_id=cons(dlhs(def),current_id);
 	        c=lineptr; lineptr=dval(def);
 		b = unify(a,etype(dval(def),env,ngt));
@@ -749,7 +1249,7 @@ word ngt;     /* ngt is list of non-generic type variables */
 		   for(d=hd[x];d!=NIL;d=tl[d])
 		      if(dtyp(hd[d])==undef_t)
 		         a=cons(hd[d],a), /* unspecified defs */
-			 dtyp(hd[d])=(b=NTV),
+			 dtyp(hd[d])=(b=ngtvar()),
 		         c=cons(b,c),  /* collect non-generic tvars */
 		         e=conforms(dlhs(hd[d]),b,e,c);
 		      else dtyp(hd[d])=meta_tcheck(dtyp(hd[d])),
@@ -822,11 +1322,14 @@ word ngt;     /* ngt is list of non-generic type variables */
 	       case FORCE:
 	       case G_UNIT:
 	       case G_RULE:
+	       case G_MEMO:
                case I:a=NTV;
                       return(tf(a,a));
                case G_ZERO:return(NTV);
                case HD:a=NTV;
                        return(tf(lt(a),a));
+	       case SORT:
+	       case LISTARRAY:
                case TL:a=lt(NTV);
                        return(tf(a,a));
                case BODY:a=NTV,b=NTV;
@@ -852,10 +1355,13 @@ word ngt;     /* ngt is list of non-generic type variables */
                case OR: return(tfbool2);
                case NOT: return(tfbool);
 	       case MERGE:
+	       case MKSET:
+	       case LISTDIFF:
                case APPEND: a=lt(NTV);
 			    return(tf2(a,a,a));
 	       case STEP: return(tstep);
 	       case STEPUNTIL: return(tstepuntil);
+	       case AMAP:
 	       case MAP: a=NTV; b=NTV;
 			 return(tf2(tf(a,b),lt(a),lt(b)));
 	       case FLATMAP: a=NTV,b=lt(NTV);
@@ -882,6 +1388,33 @@ word ngt;     /* ngt is list of non-generic type variables */
 			  return(tf2(num_t,a,a));
                case SUBSCRIPT:a=NTV;
 			      return(tf2(num_t,lt(a),a));
+	       case ASUB: a=NTV; /* array * is [*] inside its abstype */
+			  return(tf2(lt(a),num_t,a));
+	       case ASLICE: a=lt(NTV);
+			    return(tf3(num_t,num_t,a,a));
+	       case LISTTABLE: a=NTV,b=NTV;
+			       a=lt(pair_t(a,b)); /* table * ** likewise */
+			       return(tf(a,a));
+	       case TINSERT: a=NTV,b=NTV;
+			     c=lt(pair_t(a,b));
+			     return(tf3(a,b,c,c));
+	       case TLOOKUP: a=NTV,b=NTV;
+			     return(tf3(b,a,lt(pair_t(a,b)),b));
+	       case TDELETE: a=NTV;
+			     c=lt(pair_t(a,NTV));
+			     return(tf2(a,c,c));
+	       case TFOLD: a=NTV,b=NTV,d=NTV;
+			   return(tf3(tf3(a,b,d,d),d,lt(pair_t(a,b)),d));
+	       case MEMO: a=NTV,b=NTV;
+			  return(tf3(num_t,tf(a,b),a,b));
+	       case PARMAP: a=NTV,b=NTV;
+			    return(tf3(num_t,tf(a,b),lt(a),lt(b)));
+	       case LINES: return(tf(ltchar,lt(ltchar)));
+	       case SPLIT: return(tf2(char_t,ltchar,lt(ltchar)));
+	       case JOIN:
+	       case JOIN1: a=lt(NTV);
+			   return(tf2(a,lt(a),a));
+	       case SEARCH: return(tf3(num_t,num_t,ltchar,tf(ltchar,lt(num_t))));
                case P: a=NTV;
 		       b=lt(a);
 		       return(tf2(a,b,b));
@@ -897,6 +1430,7 @@ word ngt;     /* ngt is list of non-generic type variables */
 			return(tf4(tf(a,b),tf(c,a),tf(d,c),d,b));
                case C1: a=NTV,b=NTV,c=NTV,d=NTV;
 			return(tf4(tf2(a,b,c),tf(d,a),b,d,c));
+	       case PAR:
 	       case SEQ: a=NTV,b=NTV;
 			 return(tf2(a,b,b));
 	       case ITERATE1:
@@ -929,6 +1463,7 @@ word ngt;     /* ngt is list of non-generic type variables */
 	       case INTEGER: return(tf(num_t,bool_t));
 	       case CODE: return(tf(char_t,num_t));
 	       case DECODE: return(tf(num_t,char_t));
+	       case ASIZE:
 	       case LENGTH: return(tf(lt(NTV),num_t));
 	       case ENTIER_FN: case ARCTAN_FN: case EXP_FN: case SIN_FN:
 	       case COS_FN: case SQRT_FN: case LOG_FN: case LOG10_FN:
@@ -961,7 +1496,7 @@ word ngt;     /* ngt is list of non-generic type variables */
 	       case G_STATE: return(tl[hd[tl[bnf_t]]]);
 	       case G_SEQ: a=NTV; b=NTV;
 			   return(tf2(a,tf(a,b),b));
-	       /* G_RULE has same type as I */
+	       /* G_RULE, G_MEMO have same type as I */
 	       case G_CLOSE: a=NTV;
 			     if(col_fn) /* offside rule used */
 			     if(col_fn== -1) /* arbitrary flag */
@@ -1167,17 +1702,10 @@ word t1,t2;
   printf(big?"\nwith\n  ":" with ");out_type(t2);putchar('\n');
 }
 
-int unify(t1,t2) /* works by side-effecting SUBST, returns 1,0 as it succeeds
+int unify(t1,t2) /* works by binding type variables, returns 1,0 as it succeeds
 		or fails */
 word t1,t2;
-{ t1=subst(t1),t2=subst(t2);
-  if(t1==t2)return(1);
-  if(isvar_t(t1)&&!occurs(t1,t2))
-  { addsubst(t1,t2); return(1); }
-  if(isvar_t(t2)&&!occurs(t2,t1))
-  { addsubst(t2,t1); return(1); }
-  if(iscompound_t(t1)&&iscompound_t(t2)&&
-      unify1(hd[t1],hd[t2])&&unify1(tl[t1],tl[t2]))return(1);
+{ if(unify1(t1,t2))return(1);
   type_error("unify","with",t1,t2);
   return(0);
 }
@@ -1186,12 +1714,12 @@ int unify1(t1,t2) /* inner call - exactly like unify, except error reporting is
                  done only by top level, see above */
          /* we do this to avoid printing inner parts of types */
 word t1,t2;
-{ t1=subst(t1),t2=subst(t2);
+{ t1=prune(t1),t2=prune(t2);
   if(t1==t2)return(1);
-  if(isvar_t(t1)&&!occurs(t1,t2))
-  { addsubst(t1,t2); return(1); }
+  if(isvar_t(t1)&&(isvar_t(t2)||!occurs(t1,t2)))
+  { tvbind(t1,t2); return(1); }
   if(isvar_t(t2)&&!occurs(t2,t1))
-  { addsubst(t2,t1); return(1); }
+  { tvbind(t2,t1); return(1); }
   if(iscompound_t(t1)&&iscompound_t(t2))
   return(unify1(hd[t1],hd[t2])&&unify1(tl[t1],tl[t2]));
   return(0);
@@ -1206,10 +1734,11 @@ word t1,t2;
 
 word subsu1(t1,t2,T2)
 word t1,t2,T2;
-{ t1=subst(t1);
+{ t1=prune(t1);
   if(t1==t2)return(1);
   if(isvar_t(t1)&&!occurs(t1,T2))
-    { addsubst(t1,t2); return(1); }
+    { if(tvinfo(t1)&TV_NG)tvmark(t2);
+      hd[t1]=prune(t2); return(1); } /* not tvbind, which may bind t2 */
   if(iscompound_t(t1)&&iscompound_t(t2))
     return(subsu1(hd[t1],hd[t2],T2)&&subsu1(tl[t1],tl[t2],T2));
   return(0);
@@ -1228,7 +1757,7 @@ word (*f)();
 
 int occurs(tv,t)  /* does tv occur in type t? */
 word tv,t;
-{ while(iscompound_t(t))
+{ while(iscompound_t(t=prune(t)))
   { if(occurs(tv,tl[t]))return(1);
     t=hd[t]; }
   return(tv==t);
@@ -1242,48 +1771,50 @@ word t;
   return(isvar_t(t));
 }
 
-word SUBST[hashsize];  /* hash table of substitutions */
-
-int clear_SUBST()
-/* To save time and space we call this after a type inference to clear  out
-   substitutions in extinct variables.  Calling this too often can slow you
-   down - whence #define reset_SUBST, see above */
-{ word i;
-  fixshows();
-  for(i=0;i<hashsize;i++)SUBST[i]=0;
-  /*printf("tvcount=%d\n",tvcount);  /* probe */
-  tvcount=1;
-  return(0);  /* see defn of reset_SUBST */
-}
-/* doubling hashsize from 512 to 1024  speeded  typecheck  by  only  3%  on
-   parser.m (=350 line block, used c. 5000 tvars) - may be worth increasing
-   for very large programs however.  Guesstimate -  further  increase  from 
-   512 would be worthwhile on blocks>2000 lines */
-
 void fixshows()
 { while(showchain!=NIL)
        { tl[hd[showchain]]=subst(tl[hd[showchain]]);
          showchain=tl[showchain]; }
 }
 
-word lookup(tv)  /* find current substitution for type variable */
-word tv;
-{ word h=SUBST[hashval(tv)];
-  while(h)
-  { if(eqtvar(hd[hd[h]],tv))return(tl[hd[h]]);
-    h=tl[h]; }
-  return(tv);  /* no substitution found, so answer is self */
+word prune(t)  /* representative of type t, following bound variables */
+word t;
+{ word r=t,n;
+  while(isvar_t(r)&&tvbound(r))r=hd[r];
+  while(t!=r)n=hd[t],hd[t]=r,t=n; /* path compression */
+  return(r);
 }
 
-void addsubst(tv,t) /* add new substitution to SUBST */
+void tvbind(tv,t)  /* bind unbound variable tv to t, t pruned and free of tv */
 word tv,t;
-{ word h=hashval(tv);
-  SUBST[h]=cons(cons(tv,t),SUBST[h]);
+{ word i=tvinfo(tv),j;
+  if(isvar_t(t))
+    { j=tvinfo(t);
+      if((i&TV_RANK)>(j&TV_RANK))
+        { hd[tv]= -1-(i|j&TV_NG); hd[t]=tv; return; }
+      if((i&TV_RANK)==(j&TV_RANK))j++;
+      hd[t]= -1-(j|i&TV_NG); hd[tv]=t; return; }
+  if(i&TV_NG)tvmark(t);
+  hd[tv]=t;
+}
+
+void tvmark(t)  /* set TV_NG on each variable in t */
+word t;
+{ while(iscompound_t(t=prune(t)))
+  { tvmark(tl[t]);
+    t=hd[t]; }
+  if(isvar_t(t))hd[t]= -1-(tvinfo(t)|TV_NG);
+}
+
+word ngtvar()  /* new non-generic type variable */
+{ word tv=NTV;
+  hd[tv]= -1-TV_NG;
+  return(tv);
 }
 
 word ult(tv)  /* fully substituted out value of a type var */
 word tv;
-{ word s=lookup(tv);
+{ word s=prune(tv);
   return(s==tv?tv:subst(s));
 }
 
@@ -1314,8 +1845,9 @@ word t,ngt;   /* relevant tvars are those not in ngt */
 int non_generic(tv)
 word tv;
 { word x;
+  if(!tvbound(tv)&&!(tvinfo(tv)&TV_NG))return(0);
   for(x=NGT;x!=NIL;x=tl[x])
-     if(occurs(tv,subst(hd[x])))return(1);
+     if(occurs(tv,hd[x]))return(1);
   return(0);
 } /* note that when a non-generic tvar is unified against a texp, all tvars
      in texp become non-generic; this is catered for by call to subst above